@@ -6,61 +6,88 @@
 #include <cmath>
 #include <iomanip>
 #include <string>
+#include <cstdint>
 
-using namespace std;
+#include "fano.h"
 
-// a fano Node
-struct fano_node
-{
-    char c;      // character.
-    unsigned count;   // count of c.
-    double cfre; // frequency of c.
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
-    fano_node(char _c, unsigned _count, double _cfre) : c(_c), count(_count), cfre(_cfre) {}
-    ~fano_node() {}
-};
+using namespace std;
 
 bool compare_node(fano_node *a, fano_node *b) {return a->count > b->count;}
 
 // ļеַΪÿַʼڵ㣬ļʧܣ0
 // node_list Ϊ洢ʼڵ vector
-unsigned char_count(const char *file_name, list<fano_node*>&node_list)
+// ļֻʽӳ䵽ڴֱͳƣٰļƵĻ
+uint64_t char_count(const char *file_name, list<fano_node*>&node_list)
 {
-    int temp_array[256] = {0};
-    ifstream is (file_name, ifstream::binary);
-    if(is) {
-        // get length of file
-        is.seekg(0, is.end);
-        unsigned length = is.tellg();
-        is.seekg(0, is.beg);
-
-        char *buffer = new char[length]; // allocate memory
-        is.read(buffer, length);         // read data as a block
-        is.close();                      // close file
-
-        // count character
-        for(unsigned i=0; i<length; i++)
-            temp_array[buffer[i] + 128] += 1; 
-
-        delete[] buffer;
-
-        // build node_list
-        for (int i = 0; i < 256; i++) {
-            if(temp_array[i]>0) {
-                fano_node *new_node = new fano_node(char(i-128), temp_array[i], temp_array[i]/double(length));
-                node_list.push_back(new_node);
-            }
+    uint64_t temp_array[256] = {0};
+    const char *buffer = NULL;
+    uint64_t length = 0;
+
+#ifdef _WIN32
+    // FILE_FLAG_SEQUENTIAL_SCAN ʾϵͳ˳Ԥ
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(file, &size)) length = size.QuadPart;
+    HANDLE mapping = length ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    CloseHandle(file);
+    if(mapping) {
+        buffer = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);            // ӳͼᱣӳЧ
+    }
+#else
+    int fd = open(file_name, O_RDONLY);
+    if(fd < 0) return 0;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) length = st.st_size;
+    void *p = length ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(p != MAP_FAILED) {
+        // ֻͷβһ飺ӴԤʹôҳ
+        madvise(p, length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        madvise(p, length, MADV_HUGEPAGE);
+#endif
+        buffer = (const char *)p;
+    }
+#endif
+    if(!buffer) return 0;
+
+    // count character
+    for(uint64_t i=0; i<length; i++)
+        temp_array[buffer[i] + 128] += 1; 
+
+#ifdef _WIN32
+    UnmapViewOfFile(buffer);
+#else
+    munmap((void *)buffer, length);
+#endif
+
+    // build node_list
+    for (int i = 0; i < 256; i++) {
+        if(temp_array[i]>0) {
+            fano_node *new_node = new fano_node(char(i-128), temp_array[i], temp_array[i]/double(length));
+            node_list.push_back(new_node);
         }
-        return length;
     }
-
-    return 0;
+    return length;
 }
 
 // ڼŵĵݹ麯
-void fano_encode_recursive(int count_sum, list<fano_node *> &node_list_r, map<char, vector<bool>> &code_map, vector<bool> &tmp_vec)
+// ַзŵ 64 λ棬count_sum - 2 * sum_l Ϊ
+void fano_encode_recursive(int64_t count_sum, list<fano_node *> &node_list_r, map<char, vector<bool>> &code_map, vector<bool> &tmp_vec)
 {
-    int sum_l = 0;
+    int64_t sum_l = 0;
     list<fano_node *> node_list_l;
 
     fano_node *temp_node = node_list_r.front();
@@ -72,7 +99,7 @@ void fano_encode_recursive(int count_sum, list<fano_node *> &node_list_r, map<ch
     // С1˵ɼ
     else {
         // Ϊ
-        while ((temp_node->count) < (count_sum - 2 * sum_l)) {
+        while (int64_t(temp_node->count) < (count_sum - 2 * sum_l)) {
             node_list_l.push_back(temp_node);
             sum_l += temp_node->count;
 
@@ -94,7 +121,7 @@ void fano_encode_recursive(int count_sum, list<fano_node *> &node_list_r, map<ch
 }
 
 // ŵ뺯˺ node_list ֮õݹ麯ɱ
-void fano_encode(int count_sum, list<fano_node *> node_list, map<char, vector<bool> > &code_map)
+void fano_encode(int64_t count_sum, list<fano_node *> node_list, map<char, vector<bool> > &code_map)
 {
     vector<bool> tmp_vec;
     node_list.sort(compare_node); //  node_list ӴС
@@ -122,7 +149,7 @@ int main()
     const char *file_name = file_name_s.c_str();
 
     // ͳļгִֵַƵ
-    unsigned total_char = char_count(file_name, node_list); 
+    uint64_t total_char = char_count(file_name, node_list); 
 
     if (total_char == 0) {
         cout << "ERROR! we count open file or no character founded in the file." << endl;
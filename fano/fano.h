@@ -0,0 +1,26 @@
+#ifndef _FANO_H_
+#define _FANO_H_
+
+#include <list>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+// a fano Node
+struct fano_node
+{
+    char c;      // character.
+    uint64_t count;   // count of c.
+    double cfre; // frequency of c.
+
+    fano_node(char _c, uint64_t _count, double _cfre) : c(_c), count(_count), cfre(_cfre) {}
+    ~fano_node() {}
+};
+
+// count the characters in the file and create a node for each of them, return 0 if the file cannot be opened
+uint64_t char_count(const char *file_name, std::list<fano_node*> &node_list);
+
+// sort node_list and build the fano code of each character into code_map
+void fano_encode(int64_t count_sum, std::list<fano_node *> node_list, std::map<char, std::vector<bool> > &code_map);
+
+#endif
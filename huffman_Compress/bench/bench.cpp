@@ -0,0 +1,358 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "huffman.h"
+#include "huffman_stream.h"
+#include "legacy_coders.h"
+#include "alloc_stats.h"
+
+using namespace std;
+
+// 端到端基准测试：用仓库中的各个编码器依次处理合成数据与给定的文件，
+// 每次运行输出一行 JSON，包括编码、解码速度 (MB/s)、压缩率以及信源熵、平均码长、编码效率，便于在版本之间比较
+//
+// 用法：bench [-n 合成数据的字节数] [-r 重复次数] [-t 线程数] [-d 临时文件目录] [文件 ...]
+// 各项时间取重复运行中最短的一次；huffman_Compress 的每种格式分别用 DECODE_SINGLE 与 DECODE_MULTI 解码，
+// 各输出一行，由 decode_mode 区分；Huffman_C++ 与 fano 只构造码表，没有压缩与解码的结果
+// 定义 HUFFMAN_ALLOC_STATS 编译时，另外输出各项最后一次运行的分配次数、字节数与内存用量的峰值
+
+struct corpus_t
+{
+    string name;
+    vector<uint8_t> data;
+    string file;    // 旧的编码器只能读取文件，合成数据先写入临时文件
+    bool temp;
+};
+
+struct result_t
+{
+    const char *coder;
+    const char *mode;
+    const char *decode_mode;    // 解码方式，没有解码阶段时为空
+    const corpus_t *corpus;
+    double model_time;      // Encode：统计频率、构造码表，小于 0 表示没有该阶段
+    double encode_time;     // compress
+    double decode_time;     // decompress
+    uint64_t compressed;
+    double entropy;
+    double ave_length;      // 小于 0 表示无法得到
+    bool ok;
+    alloc_counters model_alloc, encode_alloc, decode_alloc;
+};
+
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 重复运行 repeat 次，返回最短的一次所用的秒数；alloc 不为空时返回最后一次运行的内存分配
+template <class F>
+static double best_time(unsigned repeat, F f, alloc_counters *alloc = nullptr)
+{
+    double best = HUGE_VAL;
+    for (unsigned r = 0; r < repeat; r++) {
+        alloc_counters begin = alloc_begin();
+        double start = now();
+        f();
+        best = min(best, now() - start);
+        alloc_counters used = alloc_end(begin);
+        if (alloc) *alloc = used;
+    }
+    return best;
+}
+
+static double entropy_of(const vector<uint8_t> &data)
+{
+    uint64_t counts[256] = {0};
+    for (uint8_t c : data) counts[c]++;
+    double h = 0.0;
+    for (unsigned i = 0; i < 256; i++) {
+        if (counts[i]) {
+            double p = counts[i] / double(data.size());
+            h -= p * log2(p);
+        }
+    }
+    return h;
+}
+
+/*************************************************************************
+* 合成数据
+*************************************************************************/
+
+static corpus_t make_corpus(const char *name, size_t len, function<uint8_t(mt19937 &)> gen)
+{
+    corpus_t corpus;
+    corpus.name = name;
+    corpus.temp = true;
+    corpus.data.resize(len);
+    mt19937 rng(12345);
+    for (size_t i = 0; i < len; i++) {
+        corpus.data[i] = gen(rng);
+    }
+    return corpus;
+}
+
+static vector<corpus_t> synthetic_corpora(size_t len)
+{
+    vector<corpus_t> corpora;
+
+    // 均匀分布：几乎不可压缩
+    corpora.push_back(make_corpus("uniform", len, [](mt19937 &rng) { return uint8_t(rng()); }));
+
+    // Zipf 分布 (s = 1.1)：接近自然语言中词频的分布
+    vector<double> weights(256);
+    for (unsigned i = 0; i < 256; i++) {
+        weights[i] = 1.0 / pow(i + 1, 1.1);
+    }
+    discrete_distribution<unsigned> zipf(weights.begin(), weights.end());
+    corpora.push_back(make_corpus("zipf", len, [&zipf](mt19937 &rng) { return uint8_t(zipf(rng)); }));
+
+    // 几何分布 (p = 0.5)：高度偏斜，码长差别很大
+    geometric_distribution<unsigned> geometric(0.5);
+    corpora.push_back(make_corpus("skewed", len, [&geometric](mt19937 &rng) {
+        return uint8_t(min(geometric(rng), 255u));
+    }));
+
+    // 随机的 0、1 两种符号
+    corpora.push_back(make_corpus("binary", len, [](mt19937 &rng) { return uint8_t(rng() & 1); }));
+
+    return corpora;
+}
+
+static bool load_corpus(const char *file, corpus_t &corpus)
+{
+    ifstream in(file, ifstream::in | ifstream::binary);
+    if (!in) return false;
+    corpus.name = file;
+    corpus.file = file;
+    corpus.temp = false;
+    corpus.data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+}
+
+/*************************************************************************
+* 各编码器
+*************************************************************************/
+
+static void print_result(const result_t &r)
+{
+    size_t bytes = r.corpus->data.size();
+    auto mbps = [bytes](double seconds) -> string {
+        if (seconds < 0) return "null";
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.2f", bytes / 1e6 / seconds);
+        return buf;
+    };
+    auto number = [](double x) -> string {
+        if (x < 0) return "null";
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.6f", x);
+        return buf;
+    };
+
+    // 文件名中的反斜杠（Windows 路径）与引号需要转义
+    string input;
+    for (char c : r.corpus->name) {
+        if (c == '\\' || c == '"') input += '\\';
+        input += c;
+    }
+
+    string decode_mode = r.decode_mode ? string("\"") + r.decode_mode + "\"" : "null";
+    printf("{\"coder\":\"%s\",\"mode\":\"%s\",\"decode_mode\":%s,\"input\":\"%s\",\"bytes\":%llu,",
+           r.coder, r.mode, decode_mode.c_str(), input.c_str(), (unsigned long long)bytes);
+    printf("\"model_mbps\":%s,\"encode_mbps\":%s,\"decode_mbps\":%s,",
+           mbps(r.model_time).c_str(), mbps(r.encode_time).c_str(), mbps(r.decode_time).c_str());
+    if (r.compressed) {
+        printf("\"compressed_bytes\":%llu,\"ratio\":%.4f,",
+               (unsigned long long)r.compressed, double(bytes) / r.compressed);
+    } else {
+        printf("\"compressed_bytes\":null,\"ratio\":null,");
+    }
+    printf("\"entropy\":%s,\"ave_length\":%s,\"efficiency\":%s,",
+           number(r.entropy).c_str(), number(r.ave_length).c_str(),
+           number(r.ave_length > 0 ? r.entropy / r.ave_length : -1).c_str());
+    if (alloc_stats_enabled()) {
+        const char *names[] = { "model", "encode", "decode" };
+        const alloc_counters *allocs[] = { &r.model_alloc, &r.encode_alloc, &r.decode_alloc };
+        const double times[] = { r.model_time, r.encode_time, r.decode_time };
+        for (unsigned i = 0; i < 3; i++) {
+            if (times[i] < 0) continue;
+            printf("\"%s_allocs\":%llu,\"%s_alloc_bytes\":%llu,\"%s_peak_bytes\":%llu,",
+                   names[i], (unsigned long long)allocs[i]->count, names[i], (unsigned long long)allocs[i]->bytes,
+                   names[i], (unsigned long long)allocs[i]->peak);
+        }
+    }
+    printf("\"ok\":%s}\n", r.ok ? "true" : "false");
+    fflush(stdout);
+}
+
+// huffman_Compress 的各种格式，数据在内存中编码、解码，不含文件读写
+static void bench_huffman(const corpus_t &corpus, unsigned repeat, unsigned threads)
+{
+    struct mode_t { const char *name; uint8_t streams; uint32_t block_size; uint8_t context_tables; };
+    const mode_t modes[] = {
+        { "canonical", 1, 0, 0 },
+        { "multi_stream", 4, 0, 0 },
+        { "block", 1, 1 << 20, 0 },
+        { "context", 1, 0, 16 },
+    };
+    struct decode_t { const char *name; Huffman::decode_mode mode; };
+    const decode_t decodes[] = {
+        { "single", Huffman::DECODE_SINGLE },
+        { "multi", Huffman::DECODE_MULTI },
+    };
+
+    const uint8_t *src = corpus.data.data();
+    size_t len = corpus.data.size();
+    for (const mode_t &mode : modes) {
+        result_t r = { "huffman_Compress", mode.name, nullptr, &corpus, -1, -1, -1, 0, -1, -1, false, {}, {}, {} };
+
+        Huffman coder;
+        coder.thread_count = threads;
+        coder.stream_count = mode.streams;
+        coder.block_size = mode.block_size;
+        coder.context_tables = mode.context_tables;
+
+        // 分块与上下文模型在 compress 中按各块、各组构造码表，不调用 Encode，没有单独的统计阶段
+        bool has_model = !mode.block_size && mode.context_tables <= 1;
+        if (has_model) {
+            r.model_time = best_time(repeat, [&]() {
+                Huffman model;
+                model.thread_count = threads;
+                model.Encode(src, len);
+            }, &r.model_alloc);
+            if (coder.Encode(src, len) != Huffman::HUFFMAN_OK) continue;
+        }
+
+        vector<uint8_t> comp, out;
+        r.encode_time = best_time(repeat, [&]() {
+            comp.clear();
+            coder.compress(src, len, comp);
+        }, &r.encode_alloc);
+        r.compressed = comp.size();
+        // 各块、各组的码长不同，按实际的输出计算平均码长
+        r.entropy = has_model ? coder.entropy : entropy_of(corpus.data);
+        r.ave_length = has_model ? coder.ave_length : (len ? comp.size() * 8.0 / len : -1);
+
+        // 同一份压缩数据分别用两种解码方式解码，统计频率与编码的结果在两行中相同
+        for (const decode_t &decode : decodes) {
+            r.decode_mode = decode.name;
+            r.decode_time = best_time(repeat, [&]() {
+                Huffman decoder;
+                decoder.thread_count = threads;
+                out.clear();
+                decoder.decompress(comp.data(), comp.size(), out, decode.mode);
+            }, &r.decode_alloc);
+            r.ok = out.size() == len && !memcmp(out.data(), src, len);
+            print_result(r);
+        }
+    }
+
+    // 自适应格式：通过流式接口编码、解码
+    result_t r = { "huffman_Compress", "adaptive", nullptr, &corpus, -1, -1, -1, 0, -1, -1, false, {}, {}, {} };
+    vector<uint8_t> comp, out, buf(HUFFMAN_STREAM_BACKLOG);
+    r.encode_time = best_time(repeat, [&]() {
+        huffman_encoder encoder;
+        comp.clear();
+        for (size_t used = 0; used < len; ) {
+            used += encoder.push(src + used, len - used);
+            while (size_t n = encoder.pull(&buf[0], buf.size())) comp.insert(comp.end(), &buf[0], &buf[0] + n);
+        }
+        encoder.finish();
+        while (size_t n = encoder.pull(&buf[0], buf.size())) comp.insert(comp.end(), &buf[0], &buf[0] + n);
+    }, &r.encode_alloc);
+    r.compressed = comp.size();
+    r.entropy = entropy_of(corpus.data);
+    r.ave_length = len ? comp.size() * 8.0 / len : -1;
+    for (const decode_t &decode : decodes) {
+        r.decode_mode = decode.name;
+        r.decode_time = best_time(repeat, [&]() {
+            huffman_decoder decoder(decode.mode);
+            out.clear();
+            for (size_t used = 0; used < comp.size(); ) {
+                used += decoder.push(&comp[used], comp.size() - used);
+                while (size_t n = decoder.pull(&buf[0], buf.size())) out.insert(out.end(), &buf[0], &buf[0] + n);
+            }
+            while (size_t n = decoder.pull(&buf[0], buf.size())) out.insert(out.end(), &buf[0], &buf[0] + n);
+        }, &r.decode_alloc);
+        r.ok = out.size() == len && !memcmp(out.data(), src, len);
+        print_result(r);
+    }
+}
+
+// Huffman_C++ 与 fano：从文件统计频率并构造码表
+static void bench_legacy(const corpus_t &corpus, unsigned repeat)
+{
+    const char *file = corpus.file.c_str();
+
+    result_t r = { "Huffman_C++", "encode", nullptr, &corpus, -1, -1, -1, 0, entropy_of(corpus.data), -1, false, {}, {}, {} };
+    r.model_time = best_time(repeat, [&]() { r.ok = legacy_huffman_encode(file); }, &r.model_alloc);
+    print_result(r);
+
+    result_t f = { "fano", "encode", nullptr, &corpus, -1, -1, -1, 0, r.entropy, -1, false, {}, {}, {} };
+    f.model_time = best_time(repeat, [&]() { f.ok = fano_encode_file(file, f.ave_length); }, &f.model_alloc);
+    print_result(f);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t len = 16 << 20;
+    unsigned repeat = 3, threads = 1;
+    string dir = ".";
+    vector<corpus_t> corpora;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            len = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            repeat = max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (argv[i][0] == '-') {
+            cerr << "Usage: " << argv[0] << " [-n bytes] [-r repeat] [-t threads] [-d temp_dir] [file ...]" << endl;
+            return 1;
+        }
+    }
+
+    corpora = synthetic_corpora(len);
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            i++;
+            continue;
+        }
+        corpus_t corpus;
+        if (!load_corpus(argv[i], corpus)) {
+            cerr << "cannot open " << argv[i] << endl;
+            return 1;
+        }
+        corpora.push_back(corpus);
+    }
+
+    for (corpus_t &corpus : corpora) {
+        if (corpus.temp) {
+            corpus.file = dir + "/bench_" + corpus.name + ".bin";
+            ofstream out(corpus.file.c_str(), ofstream::out | ofstream::binary);
+            out.write((const char *)corpus.data.data(), corpus.data.size());
+        }
+
+        bench_huffman(corpus, repeat, threads);
+        bench_legacy(corpus, repeat);
+
+        if (corpus.temp) remove(corpus.file.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include <vector>
+#include <list>
+#include <map>
+
+#include "legacy_coders.h"
+
+// 两个编码器作为单独的编译单元与基准测试一起链接（见 Makefile）：
+// Huffman_C++ 的类名与 huffman_Compress 重复，它与本文件都以 -DHuffman=cpp_coder_Huffman 编译；
+// fano.cpp 是独立的程序，编译时把其 main 改名
+#ifndef Huffman
+#error "legacy_coders.cpp must be compiled with -DHuffman=cpp_coder_Huffman, see bench/Makefile"
+#endif
+#include "../../Huffman_C++/huffman.h"
+#include "../../fano/fano.h"
+
+bool legacy_huffman_encode(const char *file)
+{
+    Huffman code;
+    return code.Encode(file) == Huffman::HUFFMAN_OK;
+}
+
+bool fano_encode_file(const char *file, double &ave_length)
+{
+    std::list<fano_node *> node_list;
+    std::map<char, std::vector<bool> > code_map;
+    uint64_t total = char_count(file, node_list);
+    bool ok = total && node_list.size() >= 2;
+    if (ok) {
+        fano_encode(total, node_list, code_map);
+        ave_length = 0.0;
+        for (fano_node *node : node_list) {
+            ave_length += node->cfre * code_map[node->c].size();
+        }
+    }
+
+    for (fano_node *node : node_list) {
+        delete node;
+    }
+    return ok;
+}
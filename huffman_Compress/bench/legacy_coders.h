@@ -0,0 +1,25 @@
+#ifndef _LEGACY_CODERS_H_
+#define _LEGACY_CODERS_H_
+
+#include <cstdint>
+
+// 仓库中其他的编码器（Huffman_C++ 与 fano），作为单独的编译单元链接到基准测试中
+// 这两个编码器只构造码表、不输出压缩数据，因此只能测量统计频率与构造码表的速度；
+// Huffman_C 是从标准输入读取至多 20 个整数权值的交互式程序，没有读取文件的接口，不参与基准测试
+
+/**
+ * @brief 用 Huffman_C++ 的编码器统计文件中各符号的频率并构造霍夫曼码
+ *
+ * @return bool - 文件打开失败或只有一种符号时返回 false
+ */
+bool legacy_huffman_encode(const char *file);
+
+/**
+ * @brief 用 fano.cpp 统计文件中各符号的频率并构造费诺码
+ *
+ * @param ave_length    - 返回平均码长
+ * @return bool         - 文件打开失败或只有一种符号时返回 false
+ */
+bool fano_encode_file(const char *file, double &ave_length);
+
+#endif
@@ -0,0 +1,294 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "huffman.h"
+#include "bitstream.h"
+
+using namespace std;
+
+// 微基准测试：分别测量比特流的基本操作与构造码表的各个函数，每项输出一行 JSON，给出每次操作的纳秒数
+//
+// 用法：microbench [-n 每轮的操作次数] [-r 重复次数]
+// 比特流写入内存而不是文件，避免磁盘的影响；各项时间取重复运行中最短的一轮
+
+// 防止被测的计算被编译器优化掉
+static volatile uint64_t sink;
+
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 重复运行 repeat 轮，返回最短一轮中每次操作的纳秒数
+static double best_ns(unsigned repeat, uint64_t ops, function<void()> f)
+{
+    double best = HUGE_VAL;
+    for (unsigned r = 0; r < repeat; r++) {
+        double start = now();
+        f();
+        best = min(best, now() - start);
+    }
+    return best * 1e9 / ops;
+}
+
+static void print_result(const char *bench, const char *dist, uint64_t ops, double ns)
+{
+    printf("{\"bench\":\"%s\",\"dist\":\"%s\",\"ops\":%llu,\"ns_per_op\":%.3f}\n",
+           bench, dist, (unsigned long long)ops, ns);
+    fflush(stdout);
+}
+
+/*************************************************************************
+* 码长与出现次数的分布
+*************************************************************************/
+
+struct length_dist_t
+{
+    const char *name;
+    function<uint8_t(mt19937 &)> gen;
+};
+
+// writbits 的码长分布：固定 8 位、1 ~ 16 位均匀分布、以短码为主、长码
+static vector<length_dist_t> length_dists()
+{
+    vector<length_dist_t> dists;
+    dists.push_back(length_dist_t{ "fixed_8", [](mt19937 &) { return uint8_t(8); } });
+    dists.push_back(length_dist_t{ "uniform_1_16", [](mt19937 &rng) { return uint8_t(1 + rng() % 16); } });
+    dists.push_back(length_dist_t{ "short", [](mt19937 &rng) {
+        return uint8_t(min(1 + geometric_distribution<unsigned>(0.5)(rng), 32u));
+    } });
+    dists.push_back(length_dist_t{ "long_24_32", [](mt19937 &rng) { return uint8_t(24 + rng() % 9); } });
+    return dists;
+}
+
+struct count_dist_t
+{
+    const char *name;
+    function<void(uint64_t *)> fill;
+};
+
+// 构造霍夫曼树时各符号出现次数的分布：等概（平衡树）、Zipf、几何分布（很深的树）、只有 16 种符号
+static vector<count_dist_t> count_dists()
+{
+    vector<count_dist_t> dists;
+    dists.push_back(count_dist_t{ "uniform_256", [](uint64_t *counts) {
+        for (unsigned i = 0; i < 256; i++) counts[i] = 1000;
+    } });
+    dists.push_back(count_dist_t{ "zipf_256", [](uint64_t *counts) {
+        for (unsigned i = 0; i < 256; i++) counts[i] = uint64_t(1e7 / pow(i + 1, 1.1)) + 1;
+    } });
+    dists.push_back(count_dist_t{ "geometric_256", [](uint64_t *counts) {
+        for (unsigned i = 0; i < 256; i++) counts[i] = (uint64_t(1) << (62 - min(i, 61u)) >> 8) + 1;
+    } });
+    dists.push_back(count_dist_t{ "uniform_16", [](uint64_t *counts) {
+        for (unsigned i = 0; i < 256; i++) counts[i] = i < 16 ? 1000 + i : 0;
+    } });
+    return dists;
+}
+
+/*************************************************************************
+* 各项测试，需访问 Huffman 的私有成员
+*************************************************************************/
+
+class huffman_microbench
+{
+  public:
+    static void writbits(uint64_t ops, unsigned repeat)
+    {
+        for (const length_dist_t &dist : length_dists()) {
+            mt19937 rng(1);
+            vector<uint8_t> bits(ops);
+            vector<uint32_t> codes(ops);
+            for (uint64_t i = 0; i < ops; i++) {
+                bits[i] = dist.gen(rng);
+                codes[i] = uint32_t(rng()) >> (32 - bits[i]);
+            }
+
+            vector<uint8_t> out;
+            out.reserve(ops * 4 + 16);
+            obitstream stream;
+            double ns = best_ns(repeat, ops, [&]() {
+                out.clear();
+                stream.open(out);
+                for (uint64_t i = 0; i < ops; i++) {
+                    stream.writbits(codes[i], bits[i]);
+                }
+                stream.close();
+            });
+            sink += out.size();
+            print_result("obitstream::writbits", dist.name, ops, ns);
+        }
+    }
+
+    static void writbyte(uint64_t ops, unsigned repeat)
+    {
+        vector<uint8_t> out;
+        out.reserve(ops + 16);
+        obitstream stream;
+        double ns = best_ns(repeat, ops, [&]() {
+            out.clear();
+            stream.open(out);
+            for (uint64_t i = 0; i < ops; i++) {
+                stream.writbyte(uint8_t(i));
+            }
+            stream.close();
+        });
+        sink += out.size();
+        print_result("obitstream::writbyte", "bytes", ops, ns);
+    }
+
+    static void readbit(uint64_t ops, unsigned repeat)
+    {
+        vector<uint8_t> data(ops / 8 + 1);
+        mt19937 rng(2);
+        for (uint8_t &b : data) b = uint8_t(rng());
+
+        ibitstream stream;
+        double ns = best_ns(repeat, ops, [&]() {
+            stream.open(data.data(), data.size());
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < ops; i++) {
+                sum += stream.readbit();
+            }
+            sink += sum;
+        });
+        print_result("ibitstream::readbit", "random", ops, ns);
+    }
+
+    static void read8bits(uint64_t ops, unsigned repeat)
+    {
+        // 先读 1 位，使之后的每个字节都跨越字节边界
+        vector<uint8_t> data(ops + 2);
+        mt19937 rng(3);
+        for (uint8_t &b : data) b = uint8_t(rng());
+
+        const char *names[] = { "aligned", "unaligned" };
+        for (unsigned offset = 0; offset < 2; offset++) {
+            ibitstream stream;
+            double ns = best_ns(repeat, ops, [&]() {
+                stream.open(data.data(), data.size());
+                if (offset) stream.readbit();
+                uint64_t sum = 0;
+                for (uint64_t i = 0; i < ops; i++) {
+                    sum += stream.read8bits();
+                }
+                sink += sum;
+            });
+            print_result("ibitstream::read8bits", names[offset], ops, ns);
+        }
+    }
+
+    // 构造码长（两种合并顺序）、限制最大码长重新构造、分配范式码字、从旧格式的先序序列重建树，每次操作为处理一整张码表
+    static void tree(uint64_t ops, unsigned repeat)
+    {
+        uint64_t trees = max<uint64_t>(ops / 1000, 1);
+        for (const count_dist_t &dist : count_dists()) {
+            Huffman coder;
+            uint64_t counts[256];
+            dist.fill(counts);
+            for (unsigned i = 0; i < 256; i++) {
+                coder.symbol_array[i].count = counts[i];
+            }
+
+            const char *names[] = { "Huffman::BuildCodeLengths", "Huffman::BuildCodeLengths(min_variance)" };
+            for (unsigned min_variance = 0; min_variance < 2; min_variance++) {
+                coder.min_variance = min_variance;
+                double ns = best_ns(repeat, trees, [&]() {
+                    for (uint64_t i = 0; i < trees; i++) {
+                        sink += coder.BuildCodeLengths();
+                    }
+                });
+                print_result(names[min_variance], dist.name, trees, ns);
+            }
+
+            double ns = best_ns(repeat, trees, [&]() {
+                for (uint64_t i = 0; i < trees; i++) {
+                    coder.LimitCodeLengths(11);
+                }
+            });
+            sink += coder.symbol_array[0].bits;
+            print_result("Huffman::LimitCodeLengths(11)", dist.name, trees, ns);
+
+            // 由码长分配范式码字
+            coder.BuildCodeLengths();
+            ns = best_ns(repeat, trees, [&]() {
+                for (uint64_t i = 0; i < trees; i++) {
+                    coder.BuildHuffmanDict();
+                }
+            });
+            sink += coder.symbol_array[0].code;
+            print_result("Huffman::BuildHuffmanDict", dist.name, trees, ns);
+
+            // 把同一张码表按旧格式的先序序列连续写入 trees 次，再依次重建
+            vector<uint8_t> data;
+            obitstream out;
+            out.open(data);
+            for (uint64_t i = 0; i < trees; i++) {
+                write_tree(out, coder, 0, 0);
+            }
+            out.close();
+
+            ibitstream in;
+            ns = best_ns(repeat, trees, [&]() {
+                in.open(data.data(), data.size());
+                for (uint64_t i = 0; i < trees; i++) {
+                    Huffman::decode_tree_node root;
+                    coder.RecoverTree(in, &root);
+                    sink += root.symbol;
+                }
+            });
+            print_result("Huffman::RecoverTree", dist.name, trees, ns);
+        }
+    }
+
+  private:
+    // 旧格式的先序序列：内部节点写 0，叶子写 1 及其 8 位符号；码字为 code 的前 bits 位的节点，左子树为码元 1
+    static void write_tree(obitstream &out, const Huffman &coder, uint32_t code, uint8_t bits)
+    {
+        for (unsigned i = 0; i < 256; i++) {
+            const Huffman::symbol_t &sym = coder.symbol_array[i];
+            if (bits && sym.bits == bits && sym.code == code) {
+                out.writbits(1, 1);
+                out.writbits(i, 8);
+                return;
+            }
+        }
+        out.writbits(0, 1);
+        write_tree(out, coder, (code << 1) + 1, bits + 1);
+        write_tree(out, coder, (code << 1) + 0, bits + 1);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t ops = 1 << 24;
+    unsigned repeat = 5;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            ops = max<uint64_t>(strtoull(argv[++i], nullptr, 10), 1);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            repeat = max(1, atoi(argv[++i]));
+        } else {
+            cerr << "Usage: " << argv[0] << " [-n ops] [-r repeat]" << endl;
+            return 1;
+        }
+    }
+
+    huffman_microbench::writbits(ops, repeat);
+    huffman_microbench::writbyte(ops, repeat);
+    huffman_microbench::readbit(ops, repeat);
+    huffman_microbench::read8bits(ops, repeat);
+    huffman_microbench::tree(ops, repeat);
+
+    return 0;
+}
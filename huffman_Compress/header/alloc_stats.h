@@ -0,0 +1,35 @@
+#ifndef _ALLOC_STATS_H_
+#define _ALLOC_STATS_H_
+
+#include <cstdint>
+
+// 编译时定义 HUFFMAN_ALLOC_STATS 则替换全局的 operator new / delete，统计分配次数、字节数与用量的峰值；
+// 未定义时不替换，以下函数返回的计数均为 0，不影响性能
+// 只统计经 operator new 的分配（包括标准容器），不含 malloc 与按对齐要求的 new
+
+// 内存分配的计数
+struct alloc_counters
+{
+    uint64_t count;     // 分配次数
+    uint64_t bytes;     // 分配的总字节数
+    uint64_t current;   // 尚未释放的字节数
+    uint64_t peak;      // current 的峰值
+};
+
+/**
+ * @brief 是否在编译时开启了分配统计
+ */
+bool alloc_stats_enabled();
+
+/**
+ * @brief 开始测量一段代码的内存分配，可以嵌套；返回值须原样传给 alloc_end
+ */
+alloc_counters alloc_begin();
+
+/**
+ * @brief 结束测量，返回其间的分配次数与字节数，current 为结束时尚未释放的字节数，
+ *        peak 为其间用量相对于开始时的最大增量；多线程同时分配时各线程的分配都计入
+ */
+alloc_counters alloc_end(const alloc_counters &begin);
+
+#endif
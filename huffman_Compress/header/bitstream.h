@@ -3,47 +3,254 @@
 
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #define BIT_STREAM_BUFFER_LEHGTH 65536
 
 // 为保证数据安全，在使用 writbits 函数之前尽量首先使用 open 函数打开文件
 // 类中并不提供保护！！！
+// 待写入的位先累积在 64 位寄存器中，攒满后一次将其中的整字节写入缓冲区
 class obitstream
 {
   public:
     obitstream();
     ~obitstream(){}
 
-    uint8_t freebits;
+    // 当前字节中尚未写入的位数
+    uint8_t freebits() const { return 8 - (nbits & 7); }
 
-    bool writbits(uint32_t x, uint8_t bits);
+    // 写入 x 的低 bits 位（bits <= 32，x 的其余位须为 0）
+    inline void writbits(uint32_t x, uint8_t bits) {
+        if (nbits + bits > 64) flushbits();
+        acc = (acc << bits) | x;
+        nbits += bits;
+    }
+
+    // 依次写入 n 个码字，第 i 个码字为 x[i] 的低 bits[i] 位
+    void writbits(const uint32_t *x, const uint8_t *bits, size_t n);
+
+    // 以下函数要求写入位置已对齐到字节边界
     void writbyte(uint8_t x);
+    void writbytes(const uint8_t *x, uint32_t n);
+
+    // 写入一段已按当前位置对齐的比特：x[0] 的高 8 - freebits() 位为 0，bits 从 x[0] 的最高位算起
+    void writshifted(const uint8_t *x, uint64_t bits);
+
     bool open(const char *filename);
+    bool open(std::ostream &stream);    // 写入外部的输出流（如 std::cout），close 时不关闭该流
+    bool open(std::vector<uint8_t> &out);           // 追加到 out 的末尾，空间随写入增长
+    bool open(uint8_t *out, size_t capacity);       // 写入调用者提供的缓冲区，超出容量的部分丢弃
     void close();
 
+    // 把已写入的整字节交给输出目标，不满一个字节的部分留待之后写入
+    void flush();
+
+    // 已输出的字节数（含因缓冲区容量不足而丢弃的部分），close 后即为完整的输出长度
+    uint64_t size() const { return written; }
+
+    // 写入调用者提供的缓冲区时容量是否不足
+    bool overflow() const { return written > capacity; }
+
+    // 写入文件或输出流时是否出错，close 之后检查则包括最后的刷新与关闭文件；写入内存时总为 false
+    bool failed() const { return os && !*os; }
+
+    // 自 open 以来把数据交给输出目标所用的墙上时间（秒）
+    double io_time() const { return io_seconds; }
+
   private:
-    uint8_t buffer[BIT_STREAM_BUFFER_LEHGTH];
+    // 缓冲区末尾多留 8 个字节，使 flushbits 总能整体写入 8 个字节
+    uint8_t buffer[BIT_STREAM_BUFFER_LEHGTH + 8];
     uint8_t *pByte;
+    uint64_t acc;     // 低 nbits 位为尚未写入缓冲区的位
+    uint8_t nbits;
     std::ofstream ofs;
+    std::ostream *os;
+    std::vector<uint8_t> *vec;
+    uint8_t *mem;
+    uint64_t capacity;
+    uint64_t written;
+    double io_seconds;
+
+    // 把 acc 中的整字节写入缓冲区，之后 nbits < 8
+    inline void flushbits() {
+        uint64_t w = nbits ? acc << (64 - nbits) : 0;
+        for (unsigned i = 0; i < 8; i++) {
+            pByte[i] = uint8_t(w >> (56 - i * 8));
+        }
+        pByte += nbits >> 3;
+        nbits &= 7;
+        if (pByte - buffer >= BIT_STREAM_BUFFER_LEHGTH) flushbuffer();
+    }
+
+    // 把缓冲区写入文件，越过缓冲区末尾的字节移到开头
+    void flushbuffer();
+
+    // 把 n 个字节交给当前的输出目标
+    void output(const uint8_t *x, size_t n);
+    void reset();
 };
 
+// 缓冲区前后各预留的字节数：前部用于保存换页时尚未读完的字节，后部补 0 以便预读越过文件末尾
+#define BIT_STREAM_PADDING 16
+
+// 已读入的位保存在 64 位寄存器中（高位在前），每次读取后从缓冲区补足到至少 56 位；
+// 补充时一次读入 8 个字节，只有缓冲区将要读完时才需要从文件换页
 class ibitstream
 {
   public:
-    ibitstream() : bitpos(0) { pByte = (uint8_t*)(&buffer[1]); }
+    ibitstream();
     ~ibitstream(){}
 
-    uint8_t readbit();
-    uint8_t read8bits();
+    uint8_t readbit() { return readbits(1); }
+    uint8_t read8bits() { return readbits(8); }
+
+    // 预读接下来的 bits 位（bits <= 32，高位在前），不移动读取位置
+    inline uint32_t peekbits(uint8_t bits) {
+        return uint32_t((bitbuf >> 1) >> (63 - bits));
+    }
+
+    // 跳过 bits 位（bits <= 32）
+    inline void skipbits(uint8_t bits) {
+        bitbuf <<= bits;
+        bitcount -= bits;
+        refill();
+    }
+
+    // 读取接下来的 bits 位（bits <= 32）
+    inline uint32_t readbits(uint8_t bits) {
+        uint32_t x = peekbits(bits);
+        skipbits(bits);
+        return x;
+    }
+
+    // 跳过当前字节剩余的位，使读取位置对齐到字节边界
+    inline void align() { skipbits(bitcount & 7); }
+
+    // 读取 n 个字节，读取位置需已对齐到字节边界；数据不足时返回 false
+    bool readbytes(uint8_t *x, uint32_t n);
+
+    // 缓冲区中尚未读取的位数；文件还有剩余数据时不少于 64
+    inline uint32_t remain_bits() const {
+        int64_t bits = int64_t(end - pByte) * 8 + bitcount;
+        return bits > 0 ? uint32_t(bits) : 0;
+    }
+
+    // 读取位置是否已越过数据末尾，即读到了末尾之后补的 0；数据被截断或损坏时解码到最后会出现
+    inline bool overrun() const {
+        return int64_t(end - pByte) * 8 + bitcount < 0;
+    }
+
     bool open(const char filename[]);
+    bool open(std::istream &stream);    // 从外部的输入流（如 std::cin）读取，close 时不关闭该流
+    bool open(const uint8_t *src, size_t len);      // 从内存读取，src 在 close 之前须保持有效
     void close();
-    uint32_t remain_bits;
+
+    // 读文件或输入流时是否出错，读到末尾不算出错
+    bool failed() const { return is && is->bad(); }
+
+    // 自 open 以来读入缓冲区的字节数，以及读入所用的墙上时间（秒）
+    uint64_t size() const { return consumed; }
+    double io_time() const { return io_seconds; }
 
   private:
-    char buffer[BIT_STREAM_BUFFER_LEHGTH+1];
-    uint8_t bitpos;
-    uint8_t *pByte;
+    uint8_t buffer[BIT_STREAM_PADDING + BIT_STREAM_BUFFER_LEHGTH + BIT_STREAM_PADDING];
+    uint64_t bitbuf;        // 高 bitcount 位为已读入、尚未使用的位
+    unsigned bitcount;
+    const uint8_t *pByte;   // 下一个要读入 bitbuf 的字节
+    const uint8_t *end;     // 缓冲区中有效数据的末尾
+    const uint8_t *limit;   // pByte 越过此处时换页；文件已读完时为 end + 8，越过后由 reload 把 pByte 留在补 0 区内
     std::ifstream ifs;
+    std::istream *is;
+    const uint8_t *mem;     // 从内存读取时尚未复制到缓冲区的数据
+    size_t mem_len;
+    uint64_t consumed;
+    double io_seconds;
+
+    // 把 bitbuf 补足到至少 56 位，常见情况下没有分支
+    inline void refill() {
+        if (pByte > limit) reload();
+        uint64_t x = 0;
+        for (unsigned i = 0; i < 8; i++) {
+            x = (x << 8) | pByte[i];
+        }
+        bitbuf |= x >> bitcount;
+        pByte += (63 - bitcount) >> 3;
+        bitcount |= 56;
+    }
+
+    // 把尚未读完的字节移到缓冲区前部的预留区，再从文件读入新的数据
+    void reload();
+    void start();
+
+    // 从输入流或内存读入至多 n 个字节，返回实际读入的字节数
+    size_t input(uint8_t *x, size_t n);
+    bool more() const { return is ? bool(*is) : mem_len > 0; }
+};
+
+// 写入内存的比特流，用于先分别生成各个子流，再整体写入文件
+class obitbuffer
+{
+  public:
+    obitbuffer() : acc(0), nbits(0) {}
+    ~obitbuffer(){}
+
+    std::vector<uint8_t> data;
+
+    // 写入 x 的低 bits 位（bits <= 32）
+    inline void writbits(uint32_t x, uint8_t bits) {
+        acc = (acc << bits) | x;
+        nbits += bits;
+        while (nbits >= 8) {
+            nbits -= 8;
+            data.push_back(uint8_t(acc >> nbits));
+        }
+    }
+
+    // 将最后不满一个字节的部分补 0 写入
+    void flush();
+    void clear() { data.clear(); acc = 0; nbits = 0; }
+
+  private:
+    uint64_t acc;
+    uint8_t nbits;
+};
+
+// 从内存读取的比特流，数据末尾之后需有 BIT_STREAM_PADDING 个 0 字节
+class ibitbuffer
+{
+  public:
+    ibitbuffer() : pByte(nullptr), bitpos(0) {}
+    ~ibitbuffer(){}
+
+    // 从 x 的第 bit 位开始读取
+    void open(const uint8_t *x, uint64_t bit = 0) { pByte = x + (bit >> 3); bitpos = bit & 7; }
+
+    inline uint32_t peekbits(uint8_t bits) {
+        uint32_t x = (uint32_t(pByte[0]) << 16) | (uint32_t(pByte[1]) << 8) | pByte[2];
+        return ((x << bitpos) & 0xFFFFFF) >> (24 - bits);
+    }
+
+    inline void skipbits(uint8_t bits) {
+        bitpos += bits;
+        pByte += bitpos >> 3;
+        bitpos &= 7;
+    }
+
+    inline uint32_t readbits(uint8_t bits) {
+        uint32_t x = peekbits(bits);
+        skipbits(bits);
+        return x;
+    }
+
+    // 当前读取位置所在的字节
+    const uint8_t *position() const { return pByte; }
+
+    // 当前读取位置相对于 x 的位数
+    uint64_t tell(const uint8_t *x) const { return uint64_t(pByte - x) * 8 + bitpos; }
+
+  private:
+    const uint8_t *pByte;
+    uint8_t bitpos;
 };
 
 #endif
\ No newline at end of file
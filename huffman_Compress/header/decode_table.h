@@ -0,0 +1,100 @@
+#ifndef _DECODE_TABLE_H_
+#define _DECODE_TABLE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// 一级查找表的索引位数，码长不超过该值的符号只需查一次表
+#define DECODE_TABLE_BITS 11
+
+// 多符号查找表中每个表项最多包含的符号个数
+#define DECODE_MULTI_SYMBOLS 4
+
+// 霍夫曼查表解码器
+// 每次从比特流中预读 N 位作为下标，一次查表即可得到一个完整的符号；
+// 码长超过 N 的符号由链接到的二级（或更深的）子表继续解码
+class decode_table
+{
+  public:
+    decode_table() : root_bits(0) {}
+    ~decode_table(){}
+
+    // 表项：bits 不为 0 时为叶子，value 为符号，bits 为该符号在本级表中占用的位数；
+    //       bits 为 0 时为链接，value 为子表起始下标，sub_bits 为子表的索引位数
+    struct entry_t
+    {
+        uint32_t value;
+        uint8_t  bits;
+        uint8_t  sub_bits;
+    };
+
+    /**
+     * @brief 根据各符号的码字与码长建立查找表
+     *
+     * @param code  - 各符号的码字（低 bits[i] 位有效，高位在前）
+     * @param bits  - 各符号的码长，0 表示该符号不存在
+     * @return bool - 码字不构成完备的前缀码时返回 false
+     */
+    bool build(const uint32_t code[256], const uint8_t bits[256]);
+
+    // 多符号表项：一次查表解出 count 个符号，共占用 bits 位；count 为 0 时退回单符号解码
+    struct multi_entry_t
+    {
+        uint8_t symbols[DECODE_MULTI_SYMBOLS];
+        uint8_t count;
+        uint8_t bits;
+    };
+
+    /**
+     * @brief 在 build 之后调用，建立 DECODE_TABLE_BITS 位下标的多符号查找表
+     */
+    void build_multi();
+
+    /**
+     * @brief 从比特流中解出一个符号，BitReader 需提供 peekbits / skipbits
+     */
+    template <class BitReader>
+    inline uint8_t decode(BitReader &in) const
+    {
+        const entry_t *tab = &table[0];
+        uint8_t tab_bits = root_bits;
+        entry_t e = tab[in.peekbits(tab_bits)];
+        while (!e.bits) {
+            in.skipbits(tab_bits);
+            tab = &table[e.value];
+            tab_bits = e.sub_bits;
+            e = tab[in.peekbits(tab_bits)];
+        }
+        in.skipbits(e.bits);
+        return uint8_t(e.value);
+    }
+
+    /**
+     * @brief 从比特流中一次解出若干个符号，写入 out（至少 DECODE_MULTI_SYMBOLS 字节），返回解出的符号个数；
+     *        剩余有效位数不少于 DECODE_TABLE_BITS 时才能调用
+     */
+    template <class BitReader>
+    inline unsigned decode_multi(BitReader &in, uint8_t *out) const
+    {
+        const multi_entry_t &m = multi[in.peekbits(DECODE_TABLE_BITS)];
+        if (m.count) {
+            memcpy(out, m.symbols, DECODE_MULTI_SYMBOLS);
+            in.skipbits(m.bits);
+            return m.count;
+        }
+        out[0] = decode(in);
+        return 1;
+    }
+
+  private:
+    uint8_t root_bits;          // 一级表的索引位数
+    std::vector<entry_t> table; // 一级表与所有子表依次存放于此
+    std::vector<multi_entry_t> multi; // 多符号表
+
+    // 为码字前 consumed 位相同的一组符号建立一张 level_bits 位的表，返回该表的起始下标
+    uint32_t build_level(const std::vector<uint8_t> &symbols, const uint32_t code[256], const uint8_t bits[256],
+                         uint8_t consumed, uint8_t level_bits);
+};
+
+#endif
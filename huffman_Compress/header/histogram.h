@@ -0,0 +1,35 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+class thread_pool;
+
+// 每轮最多统计的字节数，保证 32 位的子计数器不会溢出
+#define HISTOGRAM_ROUND_LENGTH (1u << 30)
+
+// 字节直方图：统计各字节值出现的次数
+// 计数时使用 4 个交错的子直方图，相邻的相同字节落在不同的计数器上，不必等待前一次加法写回；
+// 子直方图为紧凑的 32 位计数器，每轮结束后累加到 64 位的总数中
+class histogram
+{
+  public:
+    histogram() { clear(); }
+    ~histogram(){}
+
+    void clear();
+
+    // 统计 src 中的 len 个字节，累加到已有的结果上
+    void add(const uint8_t *src, size_t len);
+
+    // 把数据等分给线程池中的各线程分别统计，最后合并
+    void add(const uint8_t *src, size_t len, thread_pool &pool);
+
+    uint64_t operator[](unsigned symbol) const { return counts[symbol]; }
+
+  private:
+    uint64_t counts[256];
+};
+
+#endif
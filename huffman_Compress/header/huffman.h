@@ -3,24 +3,143 @@
 
 #include <iostream>
 #include <vector>
+#include <map>
+#include <functional>
 
 #include "bitstream.h"
+#include "decode_table.h"
+#include "phase_timer.h"
+
+// 多子流格式中每段的最大符号个数，每段单独记录各子流的长度
+#define HUFFMAN_SEGMENT_LENGTH (1 << 20)
+
+// 多子流格式中子流个数的上限
+#define HUFFMAN_MAX_STREAMS 16
+
+// 分块格式中块大小的上限
+#define HUFFMAN_MAX_BLOCK_SIZE (64 << 20)
+
+// 解码分块数据时，每解出这么多个符号检查一次是否读出了块的范围
+#define HUFFMAN_DECODE_CHUNK 4096
+
+// 分块格式文件末尾块索引的标识
+#define HUFFMAN_INDEX_MAGIC 0x48494458
+
+// 解码缓冲区中每块数据之后需预留的字节数，保证损坏的数据在被发现之前不会读出缓冲区
+#define HUFFMAN_BLOCK_PADDING (HUFFMAN_DECODE_CHUNK * 4 + BIT_STREAM_PADDING)
+
+// 单一比特流的符号个数达到该值时才使用多线程编码
+#define HUFFMAN_PARALLEL_MIN_LENGTH (1 << 20)
+
+// 单一比特流多线程编码时，每次读入并分给各线程的字节数
+#define HUFFMAN_PARALLEL_SEGMENT (16 << 20)
+
+// 编码时每批查表后一次写入比特流的符号个数
+#define HUFFMAN_ENCODE_BATCH 4096
+
+// 自适应格式中第一段的符号个数，之后每段加倍，直到 HUFFMAN_ADAPTIVE_SEGMENT
+#define HUFFMAN_ADAPTIVE_FIRST_SEGMENT 1024
+
+// 自适应格式中每段符号个数的上限，每段之后重建一次码表
+#define HUFFMAN_ADAPTIVE_SEGMENT (64 << 10)
+
+// 自适应格式中各符号出现次数之和超过该值时减半，使码表更多地反映最近的数据
+#define HUFFMAN_ADAPTIVE_LIMIT (1 << 20)
+
+// 自适应格式中表示同步点的段长度：其后补 0 对齐到字节边界，用于流式压缩的 flush
+#define HUFFMAN_ADAPTIVE_SYNC 0xFFFFFFFFu
+
+// 构造霍夫曼树时权重总和的上限：package-merge 中包的权重不超过总和的 32 倍，不超过该值时 64 位整数不会溢出；
+// 出现次数之和超过该值时把各权重按 2 的幂缩小（出现过的符号权重至少为 1）
+#define HUFFMAN_MAX_TOTAL_WEIGHT (uint64_t(1) << 58)
+
+// 推测式并行解码时每段编码数据的字节数
+#define HUFFMAN_SPECULATIVE_CHUNK (256 << 10)
+
+// 推测式并行解码时每段记录起始位置的符号个数，真正的起始位置须在这些符号之内与推测结果同步
+#define HUFFMAN_SYNC_WINDOW 4096
+
+// 码本文件的标识
+#define HUFFMAN_CODEBOOK_MAGIC 0x4843424B
+
+// 上下文模型中码表个数的上限
+#define HUFFMAN_MAX_CONTEXTS 64
+
+// 上下文模型中平均每张码表至少对应的符号个数，数据较少时减少码表个数，避免码长表的开销超过节省的部分
+#define HUFFMAN_CONTEXT_MIN_SYMBOLS 4096
+
+class thread_pool;
+class huffman_encoder;
+class huffman_decoder;
+class huffman_microbench;
 
 class Huffman
 {
   public:
-    Huffman() : huffman_root(nullptr) {}
-    ~Huffman() { delete huffman_root; }
+    Huffman() : max_code_length(0), min_variance(true), stream_count(1), block_size(0), thread_count(0), codebook(0),
+                context_tables(0), pipeline(false) {}
 
-    unsigned char_count; // 总的符号个数
+    uint64_t char_count; // 总的符号个数
     double entropy;      // 信源熵
     double ave_length;   // 平均码长
     double variance;     // 码长方差
     double efficiency;   // 编码效率
+    double efficiency_loss; // 限制最大码长造成的编码效率损失
+
+    // 最大码长，需在 Encode 之前设置；0 表示只受码字位数（32位）的限制
+    // 霍夫曼码的最大码长超过该值时，改用 package-merge 算法构造满足限制的最优码长
+    uint8_t max_code_length;
+
+    // 构造码长时权重相同的子树与叶子优先合并叶子，使码长的方差与最大码长最小，需在 Encode 之前设置；
+    // 关闭时优先合并子树，平均码长不变，只是码长的分布可能更分散
+    bool min_variance;
+
+    // 交错子流的个数，需在 compress 之前设置；1 表示单一比特流，
+    // 2 ~ HUFFMAN_MAX_STREAMS 表示第 i 个符号写入第 i % stream_count 个子流，解码时各子流可并行查表
+    uint8_t stream_count;
+
+    // 分块大小，需在 compress 之前设置；0 表示不分块，否则每块单独统计频率、构造码表，
+    // 各块由线程池中的 thread_count 个线程并行编码、解码（0 表示使用硬件支持的线程数），分块时不使用交错子流
+    // 分块时无需调用 Encode；不分块且只有一个比特流时，数据量较大的输入同样由这些线程并行编码，输出与单线程编码完全相同
+    uint32_t block_size;
+    unsigned thread_count;
+
+    // 压缩时使用的码本 ID，需在 compress 之前设置；0 表示不使用码本
+    // 使用码本时无需调用 Encode，文件中不保存码长表，解压缩前需用 LoadCodebook 载入同一码本
+    uint32_t codebook;
+
+    // 上下文模型的码表个数，需在 compress 之前设置；0、1 表示不使用，2 ~ HUFFMAN_MAX_CONTEXTS 表示按前一个字节选择码表：
+    // 按其后各符号的分布把 256 种前一字节聚为至多这么多组，每组一张码表，文件头保存各组的码长表与前一字节到组的映射
+    // 使用时无需调用 Encode，忽略 stream_count 与 block_size；同时设置 codebook 时使用码本
+    uint8_t context_tables;
+
+    // 流水线读写，需在 Encode、compress、decompress 之前设置；为 true 时读文件与写文件分别由单独的线程进行，
+    // 经由若干个可重复使用的缓冲区与编码解码重叠，适合磁盘较慢的情况；此时不把源文件映射到内存，
+    // 读取输入流时会一直预读到其末尾；读线程、写线程出错时与不使用流水线时一样，返回 SOURCE_ERR 或 DST_ERR
+    bool pipeline;
 
     //状态代码    HUFFMAN_OK:无问题   FILE_OPEN_ERR:文件打开失败   SOURCE_ERR:信息源存在问题
     enum huffman_err { HUFFMAN_OK = 0, FILE_OPEN_ERR, SOURCE_ERR, DST_ERR };
 
+    //解码方式    DECODE_SINGLE:每次查表解出一个符号   DECODE_MULTI:每次查表尽可能解出多个短码符号
+    enum decode_mode { DECODE_SINGLE = 0, DECODE_MULTI };
+
+    //文件格式    旧格式以先序遍历的霍夫曼树开头，首位必为0；新格式以最高位为1的格式字节开头
+    //FORMAT_CANONICAL:范式霍夫曼编码，文件头只保存各符号的码长
+    //FORMAT_MULTI_STREAM:范式霍夫曼编码，数据分段，每段由 stream_count 个交错的子流组成
+    //FORMAT_BLOCK:数据分块，每块有各自的码长表，文件末尾为各块的索引
+    //FORMAT_ADAPTIVE:自适应编码，不保存码表，编码与解码两端都按已处理的数据定期重建码表
+    //FORMAT_CODEBOOK:使用预先训练的码本，只保存码本 ID 与符号个数，适合较短的数据
+    //FORMAT_CONTEXT:一阶上下文模型，按前一个字节所属的组选择码表
+    enum stream_format { FORMAT_CANONICAL = 0x81, FORMAT_MULTI_STREAM = 0x82, FORMAT_BLOCK = 0x83, FORMAT_ADAPTIVE = 0x84,
+                         FORMAT_CODEBOOK = 0x85, FORMAT_CONTEXT = 0x86 };
+
+    //处理阶段    PHASE_READ:读取输入   PHASE_COUNT:统计频率   PHASE_TREE:构造码长   PHASE_DICT:分配码字
+    //PHASE_STATISTICS:统计各项指标   PHASE_ENCODE:压缩（不含读写）   PHASE_DECODE:解压缩（不含读写）   PHASE_WRITE:写出结果
+    //源文件映射到内存时没有显式的读取，缺页的时间计入统计频率与压缩
+    enum phase_t { PHASE_READ = 0, PHASE_COUNT, PHASE_TREE, PHASE_DICT, PHASE_STATISTICS,
+                   PHASE_ENCODE, PHASE_DECODE, PHASE_WRITE, PHASE_NUM };
+
     /**
      * @brief 打开文件并进行霍夫曼编码
      * 
@@ -34,10 +153,18 @@ class Huffman
      * 
      * @return huffman_err 函数执行结果
      */
-    huffman_err Encode(std::string);
+    huffman_err Encode(const std::string &);
 
     /**
-     * @brief 对文件进行压缩，该函数必须在 Encode(const char *) 函数后调用
+     * @brief 根据内存中的数据进行霍夫曼编码，不复制数据
+     *
+     * @param src   - 数据的起始地址
+     * @param len   - 数据的字节数
+     */
+    huffman_err Encode(const uint8_t *src, size_t len);
+
+    /**
+     * @brief 对文件进行压缩，该函数必须在 Encode(const char *) 函数后调用（分块、使用码本或上下文模型时除外）
      * 
      * @param src_file  - 源文件名
      * @param dst_file  - 压缩后的文件名
@@ -45,50 +172,138 @@ class Huffman
     huffman_err compress(const char *src_file, const char *dst_file);
 
     /**
-     * @brief 对字符串进行压缩，该函数必须在 Encode(std::string) 函数后调用
+     * @brief 对字符串进行压缩，该函数必须在 Encode(std::string) 函数后调用（分块、使用码本或上下文模型时除外）
      * 
      * @param src_str   - 源字符串
      * @param dst_file  - 压缩后的文件
      */
     huffman_err compress(std::string &src_str, const char *dst_file);
 
+    /**
+     * @brief 压缩内存中的数据，追加到 dst 的末尾，该函数必须在 Encode(const uint8_t *, size_t) 函数后调用（分块、使用码本或上下文模型时除外）
+     *
+     * @param src   - 源数据，直接从此处编码，不复制
+     * @param len   - 源数据的字节数
+     * @param dst   - 输出缓冲区，按需增长；可预先 reserve(compress_bound(len))
+     */
+    huffman_err compress(const uint8_t *src, size_t len, std::vector<uint8_t> &dst);
+
+    /**
+     * @brief 压缩内存中的数据，写入调用者提供的缓冲区，该函数必须在 Encode(const uint8_t *, size_t) 函数后调用（分块、使用码本或上下文模型时除外）
+     *
+     * @param dst_capacity  - dst 的字节数，不小于 compress_bound(len) 时一定够用
+     * @param dst_len       - 压缩后的字节数；容量不足时返回 DST_ERR，dst_len 为所需的字节数
+     */
+    huffman_err compress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_capacity, size_t &dst_len);
+
+    /**
+     * @brief 按当前的 stream_count、block_size 设置，压缩 len 个字节后输出长度的上限
+     *        （Encode 与 compress 使用相同的数据时成立）
+     */
+    size_t compress_bound(size_t len) const;
+
+    /**
+     * @brief 自适应压缩，只需读取一遍输入，可用于管道与标准输入，无需事先调用 Encode
+     *        每编码一段数据后，按已编码数据中各符号的出现次数重建码表，解码端同步重建，因此文件中不保存码表
+     *
+     * @param src   - 输入流
+     * @param dst   - 输出流，函数返回前刷新但不关闭
+     */
+    huffman_err compress(std::istream &src, std::ostream &dst);
+
     /**
      * @brief 解压缩
      * 
      * @param src_file  - 待解压缩的文件名
      * @param dst_file  - 压缩后的文件名
+     * @param mode      - 解码方式
+     */
+    huffman_err decompress(const char *src_file, const char *dst_file, decode_mode mode = DECODE_MULTI);
+
+    /**
+     * @brief 从输入流解压缩，支持各种格式，但只能依次解码，不使用块索引与推测式并行解码
+     *
+     * @param src   - 输入流
+     * @param dst   - 输出流，函数返回前刷新但不关闭
+     * @param mode  - 解码方式
      */
-    huffman_err decompress(const char *src_file, const char *dst_file);
+    huffman_err decompress(std::istream &src, std::ostream &dst, decode_mode mode = DECODE_MULTI);
+
+    /**
+     * @brief 解压缩内存中的数据，追加到 dst 的末尾；支持各种格式，数据量较大的单一比特流使用推测式并行解码
+     *
+     * @param src   - 压缩数据，src 在函数返回前须保持有效
+     * @param len   - 压缩数据的字节数
+     * @param dst   - 输出缓冲区，按需增长
+     * @param mode  - 解码方式
+     */
+    huffman_err decompress(const uint8_t *src, size_t len, std::vector<uint8_t> &dst, decode_mode mode = DECODE_MULTI);
+
+    /**
+     * @brief 解压缩内存中的数据，写入调用者提供的缓冲区
+     *
+     * @param dst_capacity  - dst 的字节数
+     * @param dst_len       - 解压后的字节数；容量不足时返回 DST_ERR，dst_len 为所需的字节数
+     */
+    huffman_err decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_capacity, size_t &dst_len,
+                           decode_mode mode = DECODE_MULTI);
+
+    /**
+     * @brief 用样本文件训练码本，保存到码本文件并载入；每个符号的出现次数加 1，保证样本中未出现的符号也有码字
+     *
+     * @param sample_file   - 样本文件，可由多条有代表性的数据拼接而成
+     * @param id            - 码本 ID，不能为 0
+     * @param codebook_file - 保存码本的文件名
+     */
+    huffman_err TrainCodebook(const char *sample_file, uint32_t id, const char *codebook_file);
+
+    /**
+     * @brief 用内存中的样本训练码本，其余同上
+     */
+    huffman_err TrainCodebook(const uint8_t *src, size_t len, uint32_t id, const char *codebook_file);
+
+    /**
+     * @brief 载入码本文件，之后可按其 ID 压缩与解压缩；同一 ID 重复载入时替换原有的码本
+     *
+     * @param codebook_file - 码本文件名
+     * @param id            - 不为空时返回码本 ID
+     */
+    huffman_err LoadCodebook(const char *codebook_file, uint32_t *id = nullptr);
 
     /**
      * @brief 显示结果，包括编码结果、信源熵、平均码长、码长方差、编码效率等
      */
     void ShowResult();
 
+    /**
+     * @brief 某一阶段的累计耗时、字节数与内存分配；Encode、compress、decompress 每次调用都累加到各阶段上
+     */
+    const phase_stats &Stats(phase_t phase) const { return stats[phase]; }
+
+    /**
+     * @brief 清零各阶段的统计
+     */
+    void ResetStats();
+
+    /**
+     * @brief 阶段的名称，如 "read"、"encode"
+     */
+    static const char *PhaseName(phase_t phase);
+
+    /**
+     * @brief 显示执行过的各阶段的墙上时间、CPU 时间、字节数与吞吐量，以及读写占总时间的比例；
+     *        定义 HUFFMAN_ALLOC_STATS 编译时还显示各阶段的分配次数、字节数与内存用量的峰值
+     *
+     * @param os    - 输出流，输出压缩数据到标准输出时可用 std::cerr
+     */
+    void ShowStats(std::ostream &os = std::cout) const;
+
   private:
-    // 霍夫曼树节点结构体
-    struct encode_tree_node
-    {
-        uint8_t symbol;     // 该节点中的符号, 把符号当作 uint8类型
-        uint32_t count;     // 符号出现的次数(该节点的权重)
-        uint8_t  depth;     // 该节点的深度，通过此变量可以保证码长方差最小
-
-        encode_tree_node *L_node;  // 左子节点指针
-        encode_tree_node *R_node;  // 右子节点指针
-
-        encode_tree_node(uint8_t _symbol, uint32_t _count,
-                         encode_tree_node *_L_node = nullptr, encode_tree_node *_R_node = nullptr);
-        ~encode_tree_node() { delete L_node, delete R_node; };
-
-        // 用于比较节点的优先级, 两两比较时，权重小的优先级大，若权重相等，则深度小的优先级大
-        class Compare {
-          public:
-            bool operator()(encode_tree_node *a, encode_tree_node *b) {
-                return (a->count == b->count ? (a -> depth > b -> depth) : (a->count > b->count));
-            }
-        };
-    };
+    friend class huffman_encoder;
+    friend class huffman_decoder;
+    friend class huffman_microbench;    // bench/microbench.cpp 直接测量构造码长等私有函数
 
+    // 旧格式文件头中的霍夫曼树，解压缩旧格式时使用
     struct decode_tree_node
     {
         char symbol;
@@ -102,21 +317,47 @@ class Huffman
     // 符号结构体
     struct symbol_t
     {
-        uint32_t count;       // 该符号出现的次数
+        uint64_t count;       // 该符号出现的次数
+        uint64_t weight;      // 构造霍夫曼树时的权重，即出现次数，总数过大时按比例缩小
         double    freq;       // 该符号的频率
         uint32_t  code;       // 该符号的霍夫曼编码，整型类型(32位整型，所以编码最长32位，即树的深度最大为32)
         uint8_t   bits;       // 该符号的编码长度
-        char *binary_code;    // 该符号的霍夫曼编码，用 0, 1 直观的表示
 
-        symbol_t() : count(0), freq(0.0), code(0), bits(0), binary_code(nullptr) {}
-        ~symbol_t() { delete [] binary_code; }
+        symbol_t() : count(0), weight(0), freq(0.0), code(0), bits(0) {}
+    };
+
+    // 块索引项，记录一块在压缩文件与原始文件中的位置
+    struct block_index_t
+    {
+        uint64_t src_offset;  // 块（含块头）在压缩文件中的偏移
+        uint64_t dst_offset;  // 块在原始文件中的偏移
+        uint32_t src_len;     // 块（含块头）的字节数
+        uint32_t dst_len;     // 块的原始字节数
+    };
+
+    // 推测式解码的一段：从猜测的位置开始解出的符号，前 HUFFMAN_SYNC_WINDOW 个符号的起始位置，以及解码结束的位置
+    struct speculative_chunk_t
+    {
+        std::vector<uint8_t>  symbols;
+        std::vector<uint64_t> starts;
+        uint64_t end;
+    };
+
+    // 载入的码本：各符号的码字与码长，以及预先建好的查找表
+    struct codebook_t
+    {
+        uint32_t code[256];
+        uint8_t  bits[256];
+        decode_table table;
     };
 
     // 由于把符号当作 uint8类型对待，所以最多有256种符号， 用数组来存储可以保证访问速度；
     symbol_t symbol_array[256];
 
     obitstream encode_stream;
-    encode_tree_node *huffman_root; // 霍夫曼树的根节点
+    double unlimited_ave_length;    // 不限制码长时的平均码长
+    std::map<uint32_t, codebook_t> codebooks;   // 已载入的码本
+    phase_stats stats[PHASE_NUM];               // 各阶段的累计耗时
 
     /**
      * @brief 从文件中统计各符号的出现次数
@@ -126,22 +367,220 @@ class Huffman
     /**
      * @brief 从字符串中统计各符号的出现次数
      */
-    bool GetFreqTable(std::string);
+    bool GetFreqTable(const std::string &);
+
+    /**
+     * @brief 从内存中统计各符号的出现次数
+     */
+    bool GetFreqTable(const uint8_t *src, size_t len);
 
     /**
-     * @brief build huffman-tree
+     * @brief 按各符号的出现次数构造不限长度的霍夫曼码长，结果写入 symbol_array[].bits，不申请堆内存
+     * @return 有多少种类的符号，只有一种时其码长为 0
      */
-    uint32_t BuildHuffmanTree();
+    uint32_t BuildCodeLengths();
 
     /**
-     * @brief 霍夫曼编码的主函数，并把霍夫曼树信息保存到输出流中，该函数调用 BuildHuffmanDictInternal 实现编码
+     * @brief 霍夫曼编码的主函数，码长超过限制时重新构造，再按码长分配范式霍夫曼码
      */
     void BuildHuffmanDict();
 
     /**
-     * @brief 先序遍历霍夫曼树以进行霍夫曼编码，该函数被 BuildHuffmanDict 调用 
+     * @brief 构造码长与码字，不足两种符号时补上不出现的符号，由各块、各组单独构造码表时使用
+     */
+    void BuildCompleteCodes();
+
+    /**
+     * @brief 把出现过的符号按 (权重, 符号) 从小到大排入 leaves
+     * @return 出现过的符号个数
+     */
+    unsigned SortedLeaves(uint8_t *leaves) const;
+
+    /**
+     * @brief 用 package-merge 算法构造最大码长不超过 max_bits 的最优码长，结果写入 symbol_array[].bits，不申请堆内存
      */
-    void BuildHuffmanDictInternal(encode_tree_node *, uint32_t, uint32_t, std::vector<char> &);
+    void LimitCodeLengths(uint8_t max_bits);
+
+    /**
+     * @brief 按 (码长, 符号) 的顺序依次分配范式霍夫曼码，码长为 0 的符号不分配
+     */
+    static void CanonicalCodes(const uint8_t *bits_arr, uint32_t *code_arr);
+
+    /**
+     * @brief 把文件格式字节与各符号的码长写入输出流
+     */
+    void WriteHeader();
+
+    /**
+     * @brief 把各符号的码长写入比特流，BitWriter 可以是 obitstream 或 obitbuffer
+     */
+    template <class BitWriter>
+    void WriteCodeLengths(BitWriter &);
+
+    /**
+     * @brief 读取 WriteCodeLengths 写入的码长表，码长表不合法或输入在码长表中途结束时返回 SOURCE_ERR
+     */
+    template <class BitReader>
+    static huffman_err ReadCodeLengths(BitReader &, uint8_t *bits_arr);
+
+    /**
+     * @brief 从输入流读取至多 n 个字节，返回实际读取的字节数，耗时计入 PHASE_READ
+     */
+    size_t ReadInput(std::istream &, uint8_t *x, size_t n);
+
+    /**
+     * @brief 结束 compress 的计时：encode_stream 写出数据的时间计入 PHASE_WRITE，
+     *        read_start 之后读取源数据的时间计入 PHASE_READ，其余计入 PHASE_ENCODE
+     */
+    void StopEncodeTimer(phase_timer &, double read_start, uint64_t bytes_in);
+
+    /**
+     * @brief 结束 decompress 的计时：两个比特流读写的时间分别计入 PHASE_READ 与 PHASE_WRITE，其余计入 PHASE_DECODE；
+     *        推测式解码直接读取内存中的输入时 ibitstream 只读入了头部，src_len 为整个输入的字节数
+     */
+    void StopDecodeTimer(phase_timer &, const ibitstream &, const obitstream &, uint64_t src_len = 0);
+
+    /**
+     * @brief 压缩文件，由 compress(const char *, const char *) 计时后调用
+     */
+    huffman_err CompressFile(const char *src_file, const char *dst_file);
+
+    /**
+     * @brief 编码输入流中的全部数据并写入 encode_stream，由 CompressFile 打开文件后调用
+     */
+    huffman_err CompressInput(std::istream &input);
+
+    /**
+     * @brief 压缩内存中的数据，写入已打开的 encode_stream；文件能映射到内存时与字符串共用此流程
+     */
+    huffman_err CompressMemory(const uint8_t *src, size_t len);
+
+    /**
+     * @brief 把一段数据逐个符号编码写入 encode_stream
+     */
+    void EncodeSymbols(const uint8_t *src, size_t len);
+
+    /**
+     * @brief 把一段数据成批查出码字与码长后写入 encode_stream，lookup(c, code, bits) 给出符号 c 的码字与码长
+     */
+    template <class Lookup>
+    void EncodeBatched(const uint8_t *src, size_t len, Lookup lookup);
+
+    /**
+     * @brief 按码本的码字与码长把一段数据编码写入 encode_stream，不改动 symbol_array
+     */
+    void EncodeSymbols(const uint8_t *src, size_t len, const codebook_t &book);
+
+    /**
+     * @brief 把一段数据按符号交错编码到 stream_count 个子流中，连同段头一起写入输出流
+     *        段头：符号个数 (32位)，各子流的字节数 (各32位)
+     */
+    void EncodeSegment(const uint8_t *src, uint32_t len);
+
+    /**
+     * @brief 依次读取 EncodeSegment 写入的各段，解码各子流并按原顺序写入输出流
+     * @param max_bits - 码长表中的最大码长，用于检查段头中各子流的字节数
+     */
+    huffman_err DecodeStreams(ibitstream &, obitstream &, const decode_table &, uint8_t streams, uint8_t max_bits);
+
+    /**
+     * @brief 多线程编码一段数据并写入 encode_stream，结果与逐个符号调用 writbits 完全相同
+     *        由各符号的码长算出每个线程负责部分的比特数，前缀和即为其在输出中的起始位置
+     */
+    void EncodeParallel(const uint8_t *src, size_t len, thread_pool &pool);
+
+    /**
+     * @brief 对一块数据单独统计频率、构造码表并编码，结果写入 out
+     *        块：压缩后的字节数 (32位)，原始字节数 (32位)，码长表，编码数据（补齐到字节边界）
+     */
+    void EncodeBlock(const uint8_t *src, uint32_t len, std::vector<uint8_t> &out);
+
+    /**
+     * @brief 分块压缩：read 每次读取至多 block_size 个字节，返回 0 表示结束；各块在线程池中并行编码，按顺序写入输出流
+     */
+    void CompressBlocks(std::function<uint32_t(uint8_t *, uint32_t)> read);
+
+    /**
+     * @brief 解码一块数据，block 为码长表及编码数据，其后需预留 HUFFMAN_BLOCK_PADDING 个 0 字节
+     */
+    static huffman_err DecodeBlock(const uint8_t *block, uint32_t block_len, uint8_t *dst, uint32_t dst_len);
+
+    /**
+     * @brief 依次读取 CompressBlocks 写入的各块，解码后写入输出流
+     */
+    static huffman_err DecompressBlocks(ibitstream &, obitstream &);
+
+    /**
+     * @brief 读取分块格式文件末尾的块索引
+     *        索引：结束块头 (8个0字节)，各块的索引项 (各24字节)，块数 (32位)，HUFFMAN_INDEX_MAGIC (32位)
+     */
+    static bool ReadBlockIndex(const char *src_file, std::vector<block_index_t> &index);
+
+    /**
+     * @brief 根据块索引在线程池中并行解码各块，每块直接写到其在解压文件中的位置
+     */
+    huffman_err DecompressBlocksParallel(const char *src_file, const char *dst_file, const std::vector<block_index_t> &index);
+
+    /**
+     * @brief 推测式并行解码单一比特流（旧格式与 FORMAT_CANONICAL）：把编码数据等分成若干段，各段从段首猜测的位置开始解码，
+     *        依靠霍夫曼码的自同步性，再用前一段真正的结束位置校验并修正猜测，最后按顺序写入输出流；
+     *        multi 为 true 时每次查表解出多个符号，table 需已调用 build_multi；
+     *        每次只读入并解码一个窗口（线程数的两倍个段），同步位置跨窗口传递，内存占用与输入大小无关；
+     *        src 不为空时整个输入在内存中（内存数据或映射的文件），长度为 src_len，直接从中读取编码数据，不经过输入流
+     */
+    huffman_err DecodeSpeculative(ibitstream &, obitstream &, const decode_table &, uint8_t zero_padding, bool multi,
+                                  const uint8_t *src = nullptr, size_t src_len = 0);
+
+    /**
+     * @brief 从 data 的第 begin 位开始解码，直到某个符号的结束位置不小于 bound
+     */
+    static void DecodeSpeculativeChunk(const uint8_t *data, uint64_t begin, uint64_t bound,
+                                       const decode_table &, bool multi, speculative_chunk_t &chunk);
+
+    /**
+     * @brief 按文件格式依次解码输入流中的全部数据，speculative 为 true 时单一比特流使用推测式并行解码；
+     *        整个输入在内存中时 src、src_len 为其地址与长度，推测式解码直接读取
+     */
+    huffman_err DecompressStream(ibitstream &, obitstream &, decode_mode mode, bool speculative,
+                                 const uint8_t *src = nullptr, size_t src_len = 0);
+
+    /**
+     * @brief 自适应格式：把一段数据计入各符号的出现次数 counts，再据此重建码表；
+     *        所有符号的出现次数都至少为 1，保证任何符号都有码字
+     */
+    void AdaptCodes(uint32_t *counts, const uint8_t *src, uint32_t len);
+
+    /**
+     * @brief 依次读取自适应格式的各段并解码，每段之后与编码端同步重建码表
+     *        文件：格式字节，最大码长 (8位)，各段的符号个数 (32位) 与编码数据，符号个数为 0 表示结束，
+     *        为 HUFFMAN_ADAPTIVE_SYNC 时跳到下一个字节边界
+     */
+    huffman_err DecodeAdaptive(ibitstream &, obitstream &, decode_mode mode);
+
+    /**
+     * @brief 由 symbol_array 中的出现次数构造码本（各次数先加 1），写入码本文件后载入
+     *        码本文件：HUFFMAN_CODEBOOK_MAGIC (32位)，码本 ID (32位)，码长表
+     */
+    huffman_err SaveCodebook(uint32_t id, const char *codebook_file);
+
+    /**
+     * @brief 解码使用码本压缩的数据
+     *        文件：格式字节，码本 ID 与符号个数（均为每字节 7 位、低位组在前的变长整数），编码数据
+     */
+    huffman_err DecodeCodebook(ibitstream &, obitstream &, decode_mode mode);
+
+    /**
+     * @brief 一阶上下文模型：统计各前一字节之后各符号的出现次数，把前一字节聚为至多 context_tables 组，
+     *        为每组构造码表，再按前一字节所属的组编码，写入 encode_stream
+     *        文件：格式字节，组数-1 (8位)，各前一字节所属的组 (各 ceil(log2(组数)) 位)，各组的码长表，
+     *        符号个数 (64位)，编码数据；第一个符号的前一字节按 0 计算
+     */
+    void EncodeContext(const uint8_t *src, size_t len);
+
+    /**
+     * @brief 解码一阶上下文模型的数据
+     */
+    huffman_err DecodeContext(ibitstream &, obitstream &);
 
     /**
      * @brief 计算信源熵、平均码长、码长方差、编码效率
@@ -149,9 +588,14 @@ class Huffman
     void Statistics();
 
     /**
-     * @brief 从压缩文件中重建霍夫曼树
+     * @brief 从压缩文件中重建霍夫曼树，树的深度超过 32 或输入在树中途结束时返回 false
+     */
+    bool RecoverTree(ibitstream &, decode_tree_node *, uint8_t depth = 0);
+
+    /**
+     * @brief 先序遍历重建的霍夫曼树，得到各符号的码字与码长，码长超过 32 位时返回 false
      */
-    void RecoverTree(ibitstream &, decode_tree_node *);
+    bool RecoverCodes(decode_tree_node *, uint32_t, uint8_t, uint32_t *, uint8_t *);
 };
 
 #endif
\ No newline at end of file
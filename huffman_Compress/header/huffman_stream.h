@@ -0,0 +1,128 @@
+#ifndef _HUFFMAN_STREAM_H_
+#define _HUFFMAN_STREAM_H_
+
+#include <vector>
+
+#include "huffman.h"
+
+// 流式压缩、解压缩时尚未取出的输出超过该字节数后不再接收输入，需先调用 pull 取出输出
+#define HUFFMAN_STREAM_BACKLOG (256 << 10)
+
+// 流式解压缩时缓存的尚未解码的输入的字节数上限
+#define HUFFMAN_STREAM_INPUT (256 << 10)
+
+// 流式压缩：调用者分次送入输入、取出输出，不需要文件或单独的线程，内存占用有上限
+// 输出为自适应格式（FORMAT_ADAPTIVE），可由 huffman_decoder 或 Huffman::decompress 解压
+class huffman_encoder
+{
+  public:
+    // max_code_length 的含义与 Huffman::max_code_length 相同
+    explicit huffman_encoder(uint8_t max_code_length = 0);
+    ~huffman_encoder(){}
+
+    /**
+     * @brief 送入输入数据
+     *
+     * @return size_t  - 实际接收的字节数；尚未取出的输出过多或已调用 finish 时少于 len
+     */
+    size_t push(const uint8_t *src, size_t len);
+
+    /**
+     * @brief 编码已接收的全部数据并对齐到字节边界，之后 pull 可取出足以解出这些数据的全部输出
+     */
+    void flush();
+
+    /**
+     * @brief 编码已接收的全部数据并写入结束标记，之后不再接收输入
+     */
+    void finish();
+
+    /**
+     * @brief 取出至多 capacity 个字节的输出，返回实际取出的字节数
+     */
+    size_t pull(uint8_t *dst, size_t capacity);
+
+    // 可以取出的输出字节数
+    size_t pending() const { return out.size() - out_pos; }
+
+    // 已接收的输入字节数
+    uint64_t total_in() const { return total; }
+
+    bool finished() const { return done; }
+
+  private:
+    Huffman model;
+    uint32_t counts[256];
+    std::vector<uint8_t> segment;   // 正在积累的一段输入
+    uint32_t segment_fill;
+    uint32_t segment_len;           // 当前段的长度，与 Huffman::compress(std::istream &, std::ostream &) 相同地逐段加倍
+    std::vector<uint8_t> out;       // 已输出、尚未取出的数据从 out_pos 开始
+    size_t out_pos;
+    uint64_t total;
+    bool done;
+
+    void encode_segment();
+
+    huffman_encoder(const huffman_encoder &);
+    huffman_encoder &operator=(const huffman_encoder &);
+};
+
+// 流式解压缩：调用者分次送入压缩数据、取出解压后的数据，只支持自适应格式
+// 每段解码完成并重建码表后，该段的数据才能被取出
+class huffman_decoder
+{
+  public:
+    explicit huffman_decoder(Huffman::decode_mode mode = Huffman::DECODE_MULTI);
+    ~huffman_decoder(){}
+
+    /**
+     * @brief 送入压缩数据并尽可能解码
+     *
+     * @return size_t  - 实际接收的字节数；缓存的输入或尚未取出的输出过多、已结束或出错时少于 len
+     */
+    size_t push(const uint8_t *src, size_t len);
+
+    /**
+     * @brief 取出至多 capacity 个字节解压后的数据，返回实际取出的字节数
+     */
+    size_t pull(uint8_t *dst, size_t capacity);
+
+    // 可以取出的输出字节数
+    size_t pending() const { return out.size() - out_pos; }
+
+    // 已读到结束标记
+    bool finished() const { return state == STATE_DONE; }
+
+    // 压缩数据不合法时为 SOURCE_ERR，之后不再接收输入
+    Huffman::huffman_err status() const { return err; }
+
+  private:
+    enum state_t { STATE_HEADER, STATE_LENGTH, STATE_SYMBOLS, STATE_DONE };
+
+    Huffman model;
+    uint32_t counts[256];
+    decode_table table;
+    Huffman::decode_mode mode;
+
+    std::vector<uint8_t> in;    // 尚未解码的输入，末尾补 BIT_STREAM_PADDING 个 0 字节
+    size_t in_len;
+    uint64_t in_bit;            // 下一个要解码的位在 in 中的位置
+    std::vector<uint8_t> segment;
+    uint32_t segment_fill;
+    uint32_t segment_len;
+    std::vector<uint8_t> out;
+    size_t out_pos;
+    state_t state;
+    Huffman::huffman_err err;
+
+    // 解码已缓存的输入，直到数据不足、输出过多、结束或出错
+    void decode();
+
+    // 解码当前段的符号，数据不足以解出下一个符号时停下
+    void decode_symbols();
+
+    huffman_decoder(const huffman_decoder &);
+    huffman_decoder &operator=(const huffman_decoder &);
+};
+
+#endif
@@ -3,7 +3,8 @@
 
 #include "huffman.h"
 
-void CommandMode(char *argv[]);
+// 命令行模式，返回进程的退出码：成功为 0，-a、-x 读写或解码失败时非 0，错误信息输出到标准错误
+int CommandMode(char *argv[]);
 
 void IndependenceMode();
 
@@ -0,0 +1,30 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// 以只读方式把整个文件映射到内存，统计频率与编码时直接读取映射的内存，省去从内核缓冲区到用户缓冲区的复制
+// 映射时提示内核按顺序预读，并在支持时使用透明大页；管道等无法映射的文件 open 返回 false，由调用者改用 ifstream 读取
+class mapped_file
+{
+  public:
+    mapped_file() : ptr(nullptr), len(0), handle(nullptr) {}
+    ~mapped_file() { close(); }
+
+    bool open(const char *filename);
+    void close();
+
+    const uint8_t *data() const { return ptr; }
+    size_t size() const { return len; }
+
+  private:
+    const uint8_t *ptr;
+    size_t len;
+    void *handle;   // Windows 下为文件映射对象的句柄
+
+    mapped_file(const mapped_file &);
+    mapped_file &operator=(const mapped_file &);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef _PHASE_TIMER_H_
+#define _PHASE_TIMER_H_
+
+#include <cstdint>
+#include "alloc_stats.h"
+
+/**
+ * @brief 单调递增的墙上时间（秒），只用于计算时间间隔
+ */
+double wall_clock();
+
+/**
+ * @brief 本进程所有线程累计使用的 CPU 时间（秒）
+ */
+double cpu_clock();
+
+// 一个处理阶段的累计耗时与数据量，同一阶段多次执行时累加
+struct phase_stats
+{
+    double   wall_time;     // 墙上时间（秒）
+    double   cpu_time;      // 进程的 CPU 时间（秒），多线程并行时可能大于 wall_time
+    uint64_t bytes_in;      // 该阶段读入或处理的字节数
+    uint64_t bytes_out;     // 该阶段产生或写出的字节数
+    uint64_t calls;         // 执行次数
+
+    // 以下只在定义 HUFFMAN_ALLOC_STATS 时统计，由 phase_timer 计入
+    uint64_t allocs;        // 分配次数
+    uint64_t alloc_bytes;   // 分配的总字节数
+    uint64_t peak_bytes;    // 各次执行中内存用量相对于开始时的最大增量
+
+    phase_stats() { clear(); }
+
+    void clear() {
+        wall_time = cpu_time = 0.0;
+        bytes_in = bytes_out = calls = 0;
+        allocs = alloc_bytes = peak_bytes = 0;
+    }
+
+    void add(double wall, double cpu, uint64_t in, uint64_t out) {
+        wall_time += wall;
+        cpu_time += cpu;
+        bytes_in += in;
+        bytes_out += out;
+        calls++;
+    }
+
+    // 吞吐量 (MB/s)，按 bytes_in 计算，只有输出的阶段按 bytes_out 计算；没有数据或耗时为 0 时为 0
+    double mbps() const;
+};
+
+// 阶段计时器：构造或 next 时开始计时，stop、next 或析构时把经过的时间与其间的内存分配累加到当前阶段
+class phase_timer
+{
+  public:
+    explicit phase_timer(phase_stats &stats) { start(stats); }
+    ~phase_timer() { stop(); }
+
+    /**
+     * @brief 结束当前阶段的计时，已结束时不做任何事
+     *
+     * @param bytes_in  - 该阶段读入或处理的字节数
+     * @param bytes_out - 该阶段产生或写出的字节数
+     * @param io_time   - 其间读写输入输出所用的墙上时间，从该阶段中扣除，由调用者计入读写的阶段
+     */
+    void stop(uint64_t bytes_in = 0, uint64_t bytes_out = 0, double io_time = 0.0);
+
+    /**
+     * @brief 结束当前阶段并开始下一阶段的计时
+     */
+    void next(phase_stats &stats, uint64_t bytes_in = 0, uint64_t bytes_out = 0, double io_time = 0.0) {
+        stop(bytes_in, bytes_out, io_time);
+        start(stats);
+    }
+
+  private:
+    phase_stats *current;   // 正在计时的阶段，已结束时为空
+    double wall;
+    double cpu;
+    alloc_counters alloc;
+
+    void start(phase_stats &stats);
+
+    phase_timer(const phase_timer &);
+    phase_timer &operator=(const phase_timer &);
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef _PIPE_STREAM_H_
+#define _PIPE_STREAM_H_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <ios>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// 每个缓冲区的字节数，较大的读写请求能减少机械硬盘的寻道
+#define PIPE_STREAM_BUFFER_SIZE (1 << 20)
+
+// 缓冲区个数，至少为 2：一个由读写线程使用，其余由编码解码线程使用或在队列中等待
+#define PIPE_STREAM_BUFFERS 4
+
+// 读写线程与编码解码线程之间的有界队列：固定个数的缓冲区在空闲队列与就绪队列之间循环使用，不重复申请内存
+// 生产者 acquire 一个空闲缓冲区、填入数据后 submit；消费者 receive 取出就绪的缓冲区、处理完后 release
+class buffer_ring
+{
+  public:
+    buffer_ring(size_t buffer_size, unsigned buffer_count);
+
+    uint8_t *buffer(unsigned i) { return buffers[i].data(); }
+    size_t buffer_size() const { return size; }
+
+    /**
+     * @brief 取出一个空闲的缓冲区，没有时等待；cancel 之后返回 false
+     */
+    bool acquire(unsigned &i);
+
+    /**
+     * @brief 把填入 len 个字节的缓冲区放入就绪队列
+     */
+    void submit(unsigned i, size_t len);
+
+    /**
+     * @brief 按 submit 的顺序取出就绪的缓冲区，没有时等待；finish 之后队列为空或 cancel 之后返回 false
+     */
+    bool receive(unsigned &i, size_t &len);
+
+    /**
+     * @brief 归还 receive 取出的缓冲区
+     */
+    void release(unsigned i);
+
+    /**
+     * @brief 等待已 submit 的缓冲区都被 release
+     */
+    void wait_idle();
+
+    // 生产者不再 submit
+    void finish();
+
+    // 放弃尚未处理的数据，唤醒所有等待的线程
+    void cancel();
+
+    // 生产者或消费者读写出错时记录下来，另一方由 failed 得知；缓冲区仍照常循环使用，不会使另一方阻塞
+    void fail();
+    bool failed();
+
+  private:
+    std::vector< std::vector<uint8_t> > buffers;
+    std::vector<size_t> lengths;
+    std::deque<unsigned> free_list;
+    std::deque<unsigned> ready;
+    size_t size;
+    unsigned pending;       // 已 submit、尚未 release 的缓冲区个数
+    bool finished;
+    bool cancelled;
+    bool error;
+    std::mutex mtx;
+    std::condition_variable cv;
+};
+
+// 由后台线程预读的输入流：读线程依次把 src 的数据读入 buffer_ring，读取时直接从已读好的缓冲区取出，
+// 读文件与之后的处理重叠进行；读线程会一直读到 src 的末尾，src 在析构之前不能由其他地方读取；
+// 读线程读 src 出错（src 置 badbit）时，已读好的数据取完之后本流置 badbit，而不是当作读到末尾
+class prefetch_istream : public std::istream
+{
+  public:
+    explicit prefetch_istream(std::istream &src, size_t buffer_size = PIPE_STREAM_BUFFER_SIZE,
+                              unsigned buffer_count = PIPE_STREAM_BUFFERS);
+    ~prefetch_istream();
+
+  private:
+    class prefetch_buf : public std::streambuf
+    {
+      public:
+        prefetch_buf(std::istream &src, size_t buffer_size, unsigned buffer_count);
+        ~prefetch_buf();
+
+      protected:
+        int_type underflow();
+
+      private:
+        buffer_ring ring;
+        std::istream &src;
+        bool holding;       // 是否持有 ring 中的一个缓冲区，即当前的读取区
+        unsigned current;
+        std::thread reader;
+
+        void read_loop();
+    };
+
+    prefetch_buf buf;
+
+    prefetch_istream(const prefetch_istream &);
+    prefetch_istream &operator=(const prefetch_istream &);
+};
+
+// 由后台线程写出的输出流：写入的数据先填入 buffer_ring 的缓冲区，填满一个就交给写线程写入 dst，
+// 之后的处理与写文件重叠进行；flush 时等待已写入的数据全部交给 dst 并刷新 dst，写出失败时置 badbit
+class writebehind_ostream : public std::ostream
+{
+  public:
+    explicit writebehind_ostream(std::ostream &dst, size_t buffer_size = PIPE_STREAM_BUFFER_SIZE,
+                                 unsigned buffer_count = PIPE_STREAM_BUFFERS);
+    ~writebehind_ostream();
+
+  private:
+    class writebehind_buf : public std::streambuf
+    {
+      public:
+        writebehind_buf(std::ostream &dst, size_t buffer_size, unsigned buffer_count);
+        ~writebehind_buf();
+
+      protected:
+        int_type overflow(int_type c);
+        int sync();
+
+      private:
+        buffer_ring ring;
+        std::ostream &dst;
+        unsigned current;   // 当前的写入区
+        std::thread writer;
+
+        // 把当前写入区交给写线程，再取一个空闲的缓冲区作为写入区
+        void submit();
+        void write_loop();
+    };
+
+    writebehind_buf buf;
+
+    writebehind_ostream(const writebehind_ostream &);
+    writebehind_ostream &operator=(const writebehind_ostream &);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// 固定大小的线程池，任务按提交顺序依次被空闲线程取出执行
+class thread_pool
+{
+  public:
+    // threads 为 0 时使用硬件支持的并发线程数
+    explicit thread_pool(unsigned threads = 0);
+    ~thread_pool();
+
+    unsigned size() const { return workers.size(); }
+
+    /**
+     * @brief 提交一个任务，返回可获取其结果的 future
+     */
+    template <class F>
+    auto submit(F f) -> std::future<decltype(f())>
+    {
+        typedef decltype(f()) result_t;
+        auto task = std::make_shared< std::packaged_task<result_t()> >(std::move(f));
+        std::future<result_t> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push([task]() { (*task)(); });
+        }
+        cv.notify_one();
+        return result;
+    }
+
+  private:
+    std::vector<std::thread> workers;
+    std::queue< std::function<void()> > tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stop;
+
+    void worker();
+};
+
+#endif
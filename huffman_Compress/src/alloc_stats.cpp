@@ -0,0 +1,124 @@
+#include "alloc_stats.h"
+
+#ifdef HUFFMAN_ALLOC_STATS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// 每块内存前留出 16 个字节记录其大小，返回的地址仍满足 malloc 的对齐要求
+#define ALLOC_HEADER 16
+
+static atomic<uint64_t> alloc_count(0);
+static atomic<uint64_t> alloc_bytes(0);
+static atomic<uint64_t> alloc_current(0);
+static atomic<uint64_t> alloc_peak(0);     // 最近一次 alloc_begin 以来的峰值
+
+static void raise_peak(uint64_t x)
+{
+    uint64_t peak = alloc_peak.load(memory_order_relaxed);
+    while (x > peak && !alloc_peak.compare_exchange_weak(peak, x, memory_order_relaxed)) {}
+}
+
+static void *counted_alloc(size_t n)
+{
+    uint8_t *p = (uint8_t *)malloc(n + ALLOC_HEADER);
+    if (!p) return nullptr;
+    *(size_t *)p = n;
+
+    alloc_count.fetch_add(1, memory_order_relaxed);
+    alloc_bytes.fetch_add(n, memory_order_relaxed);
+    raise_peak(alloc_current.fetch_add(n, memory_order_relaxed) + n);
+    return p + ALLOC_HEADER;
+}
+
+static void counted_free(void *x)
+{
+    if (!x) return;
+    uint8_t *p = (uint8_t *)x - ALLOC_HEADER;
+    alloc_current.fetch_sub(*(size_t *)p, memory_order_relaxed);
+    free(p);
+}
+
+void *operator new(size_t n)
+{
+    // 与标准的实现相同：失败时调用 new_handler，没有 new_handler 时抛出 bad_alloc
+    for (;;) {
+        if (void *p = counted_alloc(n)) return p;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+void *operator new[](size_t n) { return operator new(n); }
+
+void *operator new(size_t n, const nothrow_t &) noexcept
+{
+    try {
+        return operator new(n);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t n, const nothrow_t &) noexcept { return operator new(n, nothrow); }
+
+void operator delete(void *p) noexcept { counted_free(p); }
+void operator delete[](void *p) noexcept { counted_free(p); }
+void operator delete(void *p, size_t) noexcept { counted_free(p); }
+void operator delete[](void *p, size_t) noexcept { counted_free(p); }
+void operator delete(void *p, const nothrow_t &) noexcept { counted_free(p); }
+void operator delete[](void *p, const nothrow_t &) noexcept { counted_free(p); }
+
+bool alloc_stats_enabled()
+{
+    return true;
+}
+
+alloc_counters alloc_begin()
+{
+    // 从当前用量开始重新记录峰值，之前的峰值由 alloc_end 恢复，因此测量可以嵌套
+    alloc_counters begin;
+    begin.count = alloc_count.load(memory_order_relaxed);
+    begin.bytes = alloc_bytes.load(memory_order_relaxed);
+    begin.current = alloc_current.load(memory_order_relaxed);
+    begin.peak = alloc_peak.exchange(begin.current, memory_order_relaxed);
+    return begin;
+}
+
+alloc_counters alloc_end(const alloc_counters &begin)
+{
+    alloc_counters used;
+    used.count = alloc_count.load(memory_order_relaxed) - begin.count;
+    used.bytes = alloc_bytes.load(memory_order_relaxed) - begin.bytes;
+    used.current = alloc_current.load(memory_order_relaxed);
+    uint64_t peak = alloc_peak.load(memory_order_relaxed);
+    used.peak = peak > begin.current ? peak - begin.current : 0;
+
+    raise_peak(begin.peak);
+    return used;
+}
+
+#else
+
+bool alloc_stats_enabled()
+{
+    return false;
+}
+
+alloc_counters alloc_begin()
+{
+    alloc_counters zero = { 0, 0, 0, 0 };
+    return zero;
+}
+
+alloc_counters alloc_end(const alloc_counters &)
+{
+    alloc_counters zero = { 0, 0, 0, 0 };
+    return zero;
+}
+
+#endif
@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cstring>
 #include "bitstream.h"
+#include "phase_timer.h"
 
 using namespace std;
 
@@ -9,72 +11,166 @@ using namespace std;
 
 obitstream::obitstream()
 {
-    memset(buffer, 0, BIT_STREAM_BUFFER_LEHGTH);
+    reset();
+}
+
+void obitstream::reset()
+{
     pByte = buffer;
-    freebits = 8;
+    acc = 0;
+    nbits = 0;
+    os = nullptr;
+    vec = nullptr;
+    mem = nullptr;
+    capacity = 0;
+    written = 0;
+    io_seconds = 0.0;
 }
 
-bool obitstream::writbits(uint32_t x, uint8_t bits)
+void obitstream::output(const uint8_t *x, size_t n)
 {
-    while (bits /*&& (pByte - buffer > 65536)*/)
-    {
-        if(freebits < bits) {
-            *pByte |= (x >> (bits - freebits));
-            bits -= freebits;
-            freebits = 0;
-        } else {
-            *pByte |= (x << (freebits - bits));
-            freebits -= bits;
-            bits = 0;
-        }
+    // 每次交出整个缓冲区才计时一次，开销可以忽略
+    double start = wall_clock();
+    if (os) {
+        os->write((const char *)x, n);
+    } else if (vec) {
+        vec->insert(vec->end(), x, x + n);
+    } else if (written < capacity) {
+        memcpy(mem + written, x, size_t(min<uint64_t>(n, capacity - written)));
+    }
+    written += n;
+    io_seconds += wall_clock() - start;
+}
+
+void obitstream::flushbuffer()
+{
+    //if(ofs.is_open()) {    // 如果输出文件已经打开，则将缓存区写入文件
+                             // 由于huffman.cpp中的函数在压缩前将文件打开，所以将此项注释以优化压缩速度
+    output(buffer, BIT_STREAM_BUFFER_LEHGTH);
+    uint32_t over = pByte - buffer - BIT_STREAM_BUFFER_LEHGTH;
+    memmove(buffer, buffer + BIT_STREAM_BUFFER_LEHGTH, over);
+    pByte = buffer + over;
+    //}
+}
 
-        // 如果当前字节已经写满
-        if(!freebits) {
-            pByte++;        // 指向下一个字节
-            freebits = 8;   // 置空闲位=8
-
-            // 如果缓冲区已满
-            if (pByte - buffer >= BIT_STREAM_BUFFER_LEHGTH ) {
-                //if(ofs.is_open()) {    // 如果输出文件已经打开，则将缓存区写入文件
-                                         // 由于huffman.cpp中的函数在压缩前将文件打开，所以将此项注释以优化压缩速度
-                ofs.write((char *)buffer, BIT_STREAM_BUFFER_LEHGTH);
-                memset(buffer, 0, BIT_STREAM_BUFFER_LEHGTH);
-                pByte = buffer;
-                //}else return false;
+void obitstream::writbits(const uint32_t *x, const uint8_t *bits, size_t n)
+{
+    // 累加器与写入位置放在局部变量中，循环中不必反复读写成员
+    uint64_t a = acc;
+    unsigned used = nbits;
+    uint8_t *p = pByte;
+
+    for (size_t i = 0; i < n; i++) {
+        if (used + bits[i] > 64) {
+            uint64_t w = a << (64 - used);
+            for (unsigned k = 0; k < 8; k++) {
+                p[k] = uint8_t(w >> (56 - k * 8));
+            }
+            p += used >> 3;
+            used &= 7;
+            if (p - buffer >= BIT_STREAM_BUFFER_LEHGTH) {
+                pByte = p;
+                flushbuffer();
+                p = pByte;
             }
         }
+        a = (a << bits[i]) | x[i];
+        used += bits[i];
     }
-    return true;
+
+    acc = a;
+    nbits = used;
+    pByte = p;
 }
 
 void obitstream::writbyte(uint8_t x)
 {
+    if (nbits) flushbits();
     *pByte = x;
     ++ pByte;
-    if (pByte - buffer >= BIT_STREAM_BUFFER_LEHGTH) {
-        //if(ofs.is_open()) {    // 如果输出文件已经打开，则将缓存区写入文件
-        // 由于huffman.cpp中的函数在压缩前将文件打开，所以将此项注释以优化压缩速度
-        ofs.write((char *)buffer, BIT_STREAM_BUFFER_LEHGTH);
-        // memset(buffer, 0, BIT_STREAM_BUFFER_LEHGTH);
-        pByte = buffer;
-        //}else return false;
+    if (pByte - buffer >= BIT_STREAM_BUFFER_LEHGTH) flushbuffer();
+}
+
+void obitstream::writbytes(const uint8_t *x, uint32_t n)
+{
+    if (nbits) flushbits();
+
+    // 先填满缓冲区剩余部分，写入文件后再继续
+    while (n) {
+        uint32_t len = BIT_STREAM_BUFFER_LEHGTH - (pByte - buffer);
+        if (len > n) len = n;
+        memcpy(pByte, x, len);
+        pByte += len;
+        x += len;
+        n -= len;
+        if (pByte - buffer >= BIT_STREAM_BUFFER_LEHGTH) flushbuffer();
     }
 }
 
+void obitstream::writshifted(const uint8_t *x, uint64_t bits)
+{
+    // 第一个字节中属于本段的位与当前未写满的字节合并
+    uint8_t lead = nbits & 7;
+    if (bits < 8) {
+        writbits((x[0] >> (8 - bits)) & ((1u << (bits - lead)) - 1), bits - lead);
+        return;
+    }
+    writbits(x[0] & (0xFF >> lead), 8 - lead);
+
+    // 中间的整字节直接复制，最后不满一个字节的部分留在累加器中
+    uint64_t full = bits >> 3;
+    writbytes(x + 1, full - 1);
+    if (bits & 7) writbits(x[full] >> (8 - (bits & 7)), bits & 7);
+}
+
 bool obitstream::open(const char filename[])
 {
+    reset();
     ofs.open(filename, ofstream::out | ofstream::binary);
+    os = &ofs;
     return ofs.is_open();
 }
 
+bool obitstream::open(std::ostream &stream)
+{
+    reset();
+    os = &stream;
+    return bool(stream);
+}
+
+bool obitstream::open(std::vector<uint8_t> &out)
+{
+    reset();
+    vec = &out;
+    return true;
+}
+
+bool obitstream::open(uint8_t *out, size_t capacity)
+{
+    reset();
+    mem = out;
+    this->capacity = capacity;
+    return true;
+}
+
+void obitstream::flush()
+{
+    flushbits();
+    output(buffer, pByte - buffer);
+    pByte = buffer;
+}
+
 void obitstream::close()
 {
-    // 将缓冲区剩余内容写入文件
-    uint32_t length = (freebits == 8) ? (pByte - buffer) : (pByte - buffer + 1);
-    ofs.write((char *)buffer, length);
+    // 最后不满一个字节的部分补 0，再将缓冲区剩余内容写入文件
+    if (nbits & 7) writbits(0, 8 - (nbits & 7));
+    if (nbits) flushbits();
+    output(buffer, pByte - buffer);
+    pByte = buffer;
 
-    // 关闭文件
-    ofs.close();
+    // 关闭文件；外部传入的输出流只刷新，由调用者关闭
+    if (os == &ofs) ofs.close();
+    else if (os) os->flush();
 }
 
 
@@ -82,52 +178,145 @@ void obitstream::close()
 *  class ibitstream
 *************************************************************************/
 
+ibitstream::ibitstream()
+{
+    memset(buffer, 0, sizeof(buffer));
+    pByte = end = &buffer[BIT_STREAM_PADDING];
+    limit = buffer + sizeof(buffer);
+    is = nullptr;
+    mem = nullptr;
+    mem_len = 0;
+    consumed = 0;
+    io_seconds = 0.0;
+    bitbuf = 0;
+    bitcount = 0;
+}
+
 bool ibitstream::open(const char filename[])
 {
     ifs.open(filename, ifstream::in | ifstream::binary);
-    if(ifs.is_open()) {
-        ifs.read(&buffer[1], BIT_STREAM_BUFFER_LEHGTH);
-        remain_bits = ifs.gcount()*8;
-        return true;
-    }
+    if(ifs.is_open()) return open(ifs);
     return false;
 }
 
-void ibitstream::close()
+bool ibitstream::open(std::istream &stream)
+{
+    is = &stream;
+    mem = nullptr;
+    mem_len = 0;
+    start();
+    return true;
+}
+
+bool ibitstream::open(const uint8_t *src, size_t len)
 {
-    ifs.close();
+    // 数据仍经缓冲区读取，末尾才能补 0 供预读越界
+    is = nullptr;
+    mem = src;
+    mem_len = len;
+    start();
+    return true;
 }
 
-uint8_t ibitstream::readbit()
+void ibitstream::start()
 {
-    uint8_t x = (*pByte & (1<<(7-bitpos))) ? 1:0;
-    bitpos += 1;
-    remain_bits -= 1;
+    pByte = end = &buffer[BIT_STREAM_PADDING];
+    bitbuf = 0;
+    bitcount = 0;
+    consumed = 0;
+    io_seconds = 0.0;
+    reload();
+    refill();
+}
 
-    if(bitpos > 7) {
-        bitpos = 0;
-        ++ pByte;
+size_t ibitstream::input(uint8_t *x, size_t n)
+{
+    double start = wall_clock();
+    if (is) {
+        is->read((char *)x, n);
+        n = is->gcount();
+    } else {
+        n = min(n, mem_len);
+        memcpy(x, mem, n);
+        mem += n;
+        mem_len -= n;
     }
+    consumed += n;
+    io_seconds += wall_clock() - start;
+    return n;
+}
 
-    if(remain_bits < 9 && ifs) {
-        buffer[0] = *pByte;
-        pByte = (uint8_t*)buffer;
-        ifs.read(&buffer[1], BIT_STREAM_BUFFER_LEHGTH);
-        remain_bits = ifs.gcount() * 8 + 8;
-    }
-    return x;
+void ibitstream::close()
+{
+    if (is == &ifs) ifs.close();
 }
 
+void ibitstream::reload()
+{
+    // 输入已全部读入且读取位置越过了数据末尾：之后读到的都是末尾补的 0，
+    // 读取位置留在补 0 区内，预读不会越出缓冲区，remain_bits 保持为 0
+    if (!more() && pByte > end) {
+        pByte = end + 8;
+        return;
+    }
+
+    // 当前读取位置，bitbuf 中的位是从 pByte 之前的字节读入的
+    const uint8_t *cur = pByte - ((bitcount + 7) >> 3);
+    unsigned bitpos = (8 - (bitcount & 7)) & 7;
+
+    unsigned keep = cur < end ? end - cur : 0;
+    uint8_t *dst = &buffer[BIT_STREAM_PADDING] - keep;
+    memmove(dst, cur, keep);
+
+    size_t got = input(&buffer[BIT_STREAM_PADDING], BIT_STREAM_BUFFER_LEHGTH);
+    end = &buffer[BIT_STREAM_PADDING + got];
+    memset((uint8_t *)end, 0, BIT_STREAM_PADDING);
+    // 还有数据时读到末尾前 8 个字节换页；已读完时允许预读末尾之后补 0 的 BIT_STREAM_PADDING 个字节
+    limit = more() ? end - 8 : end + 8;
+
+    // 从对齐的字节重新读入，再跳过该字节中已读过的位
+    pByte = dst;
+    bitbuf = 0;
+    bitcount = 0;
+    if (bitpos) {
+        refill();
+        bitbuf <<= bitpos;
+        bitcount -= bitpos;
+    }
+}
 
-uint8_t ibitstream::read8bits()
+bool ibitstream::readbytes(uint8_t *x, uint32_t n)
 {
-    uint8_t x;
-    uint8_t *buf = pByte;
+    // 从当前（已对齐的）读取位置开始直接复制缓冲区中的字节
+    pByte -= bitcount >> 3;
+    bitbuf = 0;
+    bitcount = 0;
+    while (n) {
+        if (pByte >= end) {
+            if (!more()) return false;
+            reload();
+            if (pByte >= end) return false;
+        }
+        uint32_t len = end - pByte;
+        if (len > n) len = n;
+        memcpy(x, pByte, len);
+        pByte += len;
+        x += len;
+        n -= len;
+    }
+    refill();
+    return true;
+}
 
-    x = bitpos ? ((buf[0] << bitpos) | (buf[1] >> (8 - bitpos))) : *buf;
 
-    ++ pByte;
-    remain_bits -= 8;
+/*************************************************************************
+*  class obitbuffer
+*************************************************************************/
 
-    return x;
+void obitbuffer::flush()
+{
+    if (nbits) {
+        data.push_back(uint8_t(acc << (8 - nbits)));
+        nbits = 0;
+    }
 }
@@ -0,0 +1,89 @@
+#include <map>
+#include "decode_table.h"
+
+using namespace std;
+
+bool decode_table::build(const uint32_t code[256], const uint8_t bits[256])
+{
+    vector<uint8_t> symbols;
+    uint64_t kraft = 0;
+    uint8_t max_bits = 0;
+
+    for (unsigned i = 0; i < 256; i++) {
+        if (bits[i]) {
+            if (bits[i] > 32) return false;
+            symbols.push_back(uint8_t(i));
+            kraft += uint64_t(1) << (32 - bits[i]);
+            if (bits[i] > max_bits) max_bits = bits[i];
+        }
+    }
+
+    // 只有完备的前缀码才能保证每个表项都对应一个符号
+    if (kraft != (uint64_t(1) << 32)) return false;
+
+    table.clear();
+    root_bits = max_bits < DECODE_TABLE_BITS ? max_bits : DECODE_TABLE_BITS;
+    build_level(symbols, code, bits, 0, root_bits);
+
+    // 码字之间存在前缀关系时会有表项被重复填写，Kraft 和为 1 时必然留下空表项
+    for (const entry_t &e : table) {
+        if (!e.bits && !e.sub_bits) return false;
+    }
+    return true;
+}
+
+uint32_t decode_table::build_level(const vector<uint8_t> &symbols, const uint32_t code[256], const uint8_t bits[256],
+                                   uint8_t consumed, uint8_t level_bits)
+{
+    uint32_t base = table.size();
+    table.resize(base + (1u << level_bits), entry_t{0, 0, 0});
+
+    map< uint32_t, vector<uint8_t> > long_codes; // 本级表装不下的符号，按其在本级表中的下标分组
+    for (uint8_t s : symbols) {
+        uint8_t rest = bits[s] - consumed;
+        if (rest <= level_bits) {
+            // 码字剩余部分作为下标的高位，低位任意取值的表项都对应该符号
+            uint32_t first = (code[s] & ((1u << rest) - 1)) << (level_bits - rest);
+            uint32_t count = 1u << (level_bits - rest);
+            for (uint32_t i = first; i < first + count; i++) {
+                table[base + i] = entry_t{s, rest, 0};
+            }
+        } else {
+            uint32_t idx = (code[s] >> (rest - level_bits)) & ((1u << level_bits) - 1);
+            long_codes[idx].push_back(s);
+        }
+    }
+
+    for (auto &group : long_codes) {
+        uint8_t max_rest = 0;
+        for (uint8_t s : group.second) {
+            if (bits[s] - consumed - level_bits > max_rest) max_rest = bits[s] - consumed - level_bits;
+        }
+        uint8_t sub_bits = max_rest < DECODE_TABLE_BITS ? max_rest : DECODE_TABLE_BITS;
+        uint32_t sub_base = build_level(group.second, code, bits, consumed + level_bits, sub_bits);
+        table[base + group.first] = entry_t{sub_base, 0, sub_bits};
+    }
+
+    return base;
+}
+
+void decode_table::build_multi()
+{
+    // 多符号表固定使用 DECODE_TABLE_BITS 位下标，一级表较窄时也能在一次查表中容纳多个符号
+    uint32_t mask = (1u << DECODE_TABLE_BITS) - 1;
+    multi.assign(1u << DECODE_TABLE_BITS, multi_entry_t());
+
+    for (uint32_t i = 0; i <= mask; i++) {
+        multi_entry_t &m = multi[i];
+
+        // 在下标的位数内依次解码，直到遇到码字跨出下标范围的符号
+        uint8_t used = 0;
+        while (m.count < DECODE_MULTI_SYMBOLS) {
+            const entry_t &e = table[((i << used) & mask) >> (DECODE_TABLE_BITS - root_bits)];
+            if (!e.bits || used + e.bits > DECODE_TABLE_BITS) break;
+            m.symbols[m.count++] = uint8_t(e.value);
+            used += e.bits;
+        }
+        m.bits = used;
+    }
+}
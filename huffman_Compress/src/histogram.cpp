@@ -0,0 +1,68 @@
+#include <cstring>
+#include <vector>
+#include <future>
+#include "histogram.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+void histogram::clear()
+{
+    memset(counts, 0, sizeof(counts));
+}
+
+void histogram::add(const uint8_t *src, size_t len)
+{
+    uint32_t sub[4][256];
+
+    while (len) {
+        size_t n = len < HISTOGRAM_ROUND_LENGTH ? len : HISTOGRAM_ROUND_LENGTH;
+        memset(sub, 0, sizeof(sub));
+
+        // 每次读入 8 个字节，依次分给 4 个子直方图
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t x;
+            memcpy(&x, src + i, 8);
+            sub[0][x & 0xFF]++;
+            sub[1][(x >> 8) & 0xFF]++;
+            sub[2][(x >> 16) & 0xFF]++;
+            sub[3][(x >> 24) & 0xFF]++;
+            sub[0][(x >> 32) & 0xFF]++;
+            sub[1][(x >> 40) & 0xFF]++;
+            sub[2][(x >> 48) & 0xFF]++;
+            sub[3][x >> 56]++;
+        }
+        for (; i < n; i++) {
+            sub[0][src[i]]++;
+        }
+
+        for (unsigned s = 0; s < 256; s++) {
+            counts[s] += uint64_t(sub[0][s]) + sub[1][s] + sub[2][s] + sub[3][s];
+        }
+        src += n;
+        len -= n;
+    }
+}
+
+void histogram::add(const uint8_t *src, size_t len, thread_pool &pool)
+{
+    unsigned parts = pool.size();
+    size_t part_len = (len + parts - 1) / parts;
+
+    vector<histogram> partial(parts);
+    vector< future<void> > done;
+    for (unsigned t = 0; t < parts && t * part_len < len; t++) {
+        size_t begin = t * part_len;
+        size_t n = len - begin < part_len ? len - begin : part_len;
+        histogram *h = &partial[t];
+        done.push_back(pool.submit([h, src, begin, n]() { h->add(src + begin, n); }));
+    }
+    for (future<void> &f : done) f.get();
+
+    for (unsigned t = 0; t < parts; t++) {
+        for (unsigned s = 0; s < 256; s++) {
+            counts[s] += partial[t].counts[s];
+        }
+    }
+}
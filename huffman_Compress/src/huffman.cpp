@@ -1,18 +1,70 @@
 #include <fstream>
-#include <queue>
 #include <cmath>
 #include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <cstring>
 
 #include "huffman.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "histogram.h"
+#include "huffman_stream.h"
+#include "pipe_stream.h"
 
 using namespace std;
 
-Huffman::encode_tree_node::encode_tree_node(uint8_t _symbol, uint32_t _count, encode_tree_node *_L_node, encode_tree_node *_R_node) :
-                              symbol(_symbol), count(_count), L_node(_L_node), R_node(_R_node) {
-    if (L_node && R_node)
-        depth = L_node->depth > R_node->depth ? L_node->depth + 1 : R_node->depth + 1;
-    else
-        depth = 0;
+// 分块格式中的整数均为高字节在前
+static inline uint32_t load_be32(const uint8_t *p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static inline void store_be32(uint8_t *p, uint32_t x)
+{
+    p[0] = uint8_t(x >> 24);
+    p[1] = uint8_t(x >> 16);
+    p[2] = uint8_t(x >> 8);
+    p[3] = uint8_t(x);
+}
+
+static inline uint64_t load_be64(const uint8_t *p)
+{
+    return (uint64_t(load_be32(p)) << 32) | load_be32(p + 4);
+}
+
+static inline void store_be64(uint8_t *p, uint64_t x)
+{
+    store_be32(p, uint32_t(x >> 32));
+    store_be32(p + 4, uint32_t(x));
+}
+
+// 码本格式中的变长整数：每字节保存 7 位，低位组在前，最高位为 1 表示还有后续字节
+static void write_varint(obitstream &out, uint64_t x)
+{
+    while (x >= 0x80) {
+        out.writbits(uint8_t(x) | 0x80, 8);
+        x >>= 7;
+    }
+    out.writbits(uint8_t(x), 8);
+}
+
+static bool read_varint(ibitstream &in, uint64_t &x)
+{
+    x = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (in.remain_bits() < 8) return false;
+        uint8_t b = in.readbits(8);
+        x |= uint64_t(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// 实际可用的线程数，threads 为 0 时取硬件支持的并发线程数
+static inline unsigned resolve_threads(unsigned threads)
+{
+    return threads ? threads : thread::hardware_concurrency();
 }
 
 /**
@@ -20,23 +72,29 @@ Huffman::encode_tree_node::encode_tree_node(uint8_t _symbol, uint32_t _count, en
  */
 bool Huffman::GetFreqTable(const char *filename)
 {
+    // 源文件能映射到内存时直接统计映射的数据，流水线方式下由读线程读取
+    mapped_file mapped;
+    if (!pipeline && mapped.open(filename)) return GetFreqTable(mapped.data(), mapped.size());
+
     char buffer[65536];
-    uint8_t *u8_buffer = (uint8_t *)buffer;
+    histogram hist;
     char_count = 0;
 
     ifstream infile(filename, ifstream::in | ifstream::binary);
 
     if(infile) {
+        unique_ptr<prefetch_istream> prefetch(pipeline ? new prefetch_istream(infile) : nullptr);
+        istream &input = prefetch ? *prefetch : static_cast<istream &>(infile);
         do {
-            unsigned i;
-            infile.read((char *)buffer, 65536);
-            for (i = 0; i < infile.gcount(); i++) {
-                symbol_array[u8_buffer[i]].count += 1;
-            }
-            char_count += i;
-        } while (infile);
+            size_t n = ReadInput(input, (uint8_t *)buffer, 65536);
+            hist.add((uint8_t *)buffer, n);
+            char_count += n;
+        } while (input);
+        // 读文件出错（流水线方式下由读线程出错）时不能当作读到末尾
+        if(input.bad()) return false;
 
         for (unsigned i = 0; i < 256; i++) {
+            symbol_array[i].count += hist[i];
             symbol_array[i].freq = symbol_array[i].count / double(char_count);
         }
         infile.close();
@@ -47,15 +105,29 @@ bool Huffman::GetFreqTable(const char *filename)
 /**
  * @brief 从字符串中统计各符号的出现次数
  */
-bool Huffman::GetFreqTable(string input_str)
+bool Huffman::GetFreqTable(const string &input_str)
+{
+    return GetFreqTable((const uint8_t *)input_str.data(), input_str.size());
+}
+
+/**
+ * @brief 从内存中统计各符号的出现次数
+ */
+bool Huffman::GetFreqTable(const uint8_t *src, size_t len)
 {
-    char_count = input_str.size();
+    char_count = len;
 
-    for (unsigned i = 0; i < char_count; i++) {
-        symbol_array[uint8_t(input_str[i])].count += 1;
+    // 数据量较大时由线程池中的各线程分别统计一部分
+    histogram hist;
+    if (resolve_threads(thread_count) > 1 && len >= HUFFMAN_PARALLEL_MIN_LENGTH) {
+        thread_pool pool(thread_count);
+        hist.add(src, len, pool);
+    } else {
+        hist.add(src, len);
     }
 
     for (unsigned i = 0; i < 256; i++) {
+        symbol_array[i].count += hist[i];
         symbol_array[i].freq = symbol_array[i].count / double(char_count);
     }
 
@@ -63,82 +135,325 @@ bool Huffman::GetFreqTable(string input_str)
 }
 
 /**
- * @brief 构造霍夫曼树
- * @return 有多少种类的符号
+ * @brief 把出现过的符号按 (权重, 符号) 从小到大排入 leaves
+ * @return 出现过的符号个数
  */
-uint32_t Huffman::BuildHuffmanTree()
+unsigned Huffman::SortedLeaves(uint8_t *leaves) const
 {
-    uint32_t kind_of_symbol = 0;
-    // 初始化树节点，并将其放到优先级队列中，保证每次弹出的都是权值最小的（若权值相等则弹出深度较小的）
-    priority_queue< encode_tree_node*, vector< encode_tree_node*>, encode_tree_node::Compare > node_queue;
+    unsigned n = 0;
+    for (unsigned i = 0; i < 256; i++) {
+        if (symbol_array[i].weight) leaves[n++] = uint8_t(i);
+    }
+    // 权重相同时按符号排序，结果与排序算法无关；sort 不像 stable_sort 那样申请缓冲区
+    sort(leaves, leaves + n, [this](uint8_t a, uint8_t b) {
+        return symbol_array[a].weight != symbol_array[b].weight ? symbol_array[a].weight < symbol_array[b].weight : a < b;
+    });
+    return n;
+}
 
+/**
+ * @brief 按各符号的出现次数构造不限长度的霍夫曼码长，结果写入 symbol_array[].bits，不申请堆内存
+ * @return 有多少种类的符号，只有一种时其码长为 0
+ */
+uint32_t Huffman::BuildCodeLengths()
+{
+    // 出现次数之和过大时按比例缩小权重，保证构造过程中的加法不会溢出，出现次数本身保持不变
+    uint64_t total = 0;
     for (unsigned i = 0; i < 256; i++) {
-        if (symbol_array[i].count) {
-            encode_tree_node *node = new encode_tree_node(i, symbol_array[i].count);
-            node_queue.push(node);
-            kind_of_symbol ++;
-        }
+        total += symbol_array[i].count;
+    }
+    unsigned shift = 0;
+    while ((total >> shift) > HUFFMAN_MAX_TOTAL_WEIGHT) shift++;
+    for (unsigned i = 0; i < 256; i++) {
+        uint64_t count = symbol_array[i].count;
+        symbol_array[i].weight = count ? max<uint64_t>(count >> shift, 1) : 0;
+        symbol_array[i].bits = 0;
     }
 
-    encode_tree_node *root = NULL;
-    while(node_queue.size() > 1) {
-        // 取出最小的作为左子树
-        encode_tree_node *left = node_queue.top();
-        node_queue.pop();
+    uint8_t leaves[256];
+    unsigned n = SortedLeaves(leaves);
+    if (n < 2) return n;
+
+    // Moffat-Katajainen 的原地算法：a 按权重从小到大存放各叶子，合并过程中依次被改写为
+    // 内部节点的权重、内部节点的父节点下标、内部节点的深度，最后为各叶子的码长
+    uint64_t a[256];
+    for (unsigned i = 0; i < n; i++) {
+        a[i] = symbol_array[leaves[i]].weight;
+    }
 
-        // 取出次小的作为右子树
-        encode_tree_node *right = node_queue.top();
-        node_queue.pop();
+    // 第一遍：两个队列分别是尚未合并的叶子 a[leaf..n) 与尚未合并的内部节点 a[root..next)，
+    // 每次取两个最小的合并为内部节点 next，其权重存入 a[next]，被合并的内部节点改存其父节点下标
+    // 权重相同时 min_variance 优先取叶子，使树尽量矮，即码长方差最小的霍夫曼树
+    a[0] += a[1];
+    unsigned root = 0, leaf = 2;
+    for (unsigned next = 1; next < n - 1; next++) {
+        for (unsigned child = 0; child < 2; child++) {
+            uint64_t weight;
+            if (leaf >= n || (root < next && (min_variance ? a[root] < a[leaf] : a[root] <= a[leaf]))) {
+                weight = a[root];
+                a[root++] = next;
+            } else {
+                weight = a[leaf++];
+            }
+            a[next] = child ? a[next] + weight : weight;
+        }
+    }
 
-        // 创建新树
-        root = new encode_tree_node(0, left->count + right->count, left, right);
+    // 第二遍：根节点 n-2 的深度为 0，其余内部节点的深度为父节点的深度加 1
+    a[n - 2] = 0;
+    for (int next = int(n) - 3; next >= 0; next--) {
+        a[next] = a[a[next]] + 1;
+    }
 
-        // 将新树放入到队列中
-        node_queue.push(root);
+    // 第三遍：逐层统计内部节点的个数，每层其余的位置都是叶子，权重大的叶子得到较短的码长
+    int internal = int(n) - 2, next = int(n) - 1;
+    unsigned avail = 1, depth = 0;
+    while (avail > 0) {
+        unsigned used = 0;
+        while (internal >= 0 && a[internal] == depth) {
+            used++;
+            internal--;
+        }
+        while (avail > used) {
+            a[next--] = depth;
+            avail--;
+        }
+        avail = 2 * used;
+        depth++;
     }
-    delete huffman_root; // 删除旧的根节点以保证所有通过new申请的空间得到释放
-    huffman_root = root; // 新的根节点
 
-    return kind_of_symbol;
+    // 码长不超过 n-1 <= 255，超过最大码长时由 BuildHuffmanDict 重新构造
+    for (unsigned i = 0; i < n; i++) {
+        symbol_array[leaves[i]].bits = uint8_t(a[i]);
+    }
+    return n;
 }
 
 /**
- * @brief 先序遍历霍夫曼树以进行霍夫曼编码，该函数被 BuildHuffmanDict 调用 
+ * @brief 用 package-merge 算法构造最大码长不超过 max_bits 的最优码长，结果写入 symbol_array[].bits，不申请堆内存
  */
-void Huffman::BuildHuffmanDictInternal(encode_tree_node *root_node, uint32_t code, uint32_t bits, vector<char> &tmp_vec)
+void Huffman::LimitCodeLengths(uint8_t max_bits)
 {
-    uint8_t leaf_symbol;
-    if(root_node->L_node == NULL && root_node->R_node == NULL) {
-        leaf_symbol = root_node->symbol;
+    uint8_t leaves[256];
+    unsigned n = SortedLeaves(leaves);
+    if (n < 2) return;
 
-        symbol_array[leaf_symbol].code = code;
-        symbol_array[leaf_symbol].bits = bits;
-        symbol_array[leaf_symbol].binary_code = new char[tmp_vec.size()];
-        memcpy(symbol_array[leaf_symbol].binary_code, &tmp_vec[0], tmp_vec.size());
+    // 码长至少要能容纳 n 个符号
+    while ((uint64_t(1) << max_bits) < n) max_bits++;
 
-        encode_stream.writbits(1, 1);
-        encode_stream.writbits(root_node->symbol, 8);
-    } else {
-        encode_stream.writbits(0, 1);
+    // 第 l 层的列表由全部叶子与第 l-1 层的列表两两打包得到的包按权重归并而成（权重相同时叶子在前），
+    // 各层的列表都少于 2n 项，包少于 n 个；只保存各层包的权重，叶子与包的先后顺序在需要时重新归并得到
+    // 工作区共 32 * 256 * 8 = 64KB，放在栈上
+    uint64_t packages[32][256];
+    unsigned package_count[32];
+    package_count[0] = 0;
+
+    // 依次给出第 l 层列表中各项的权重，is_leaf 表示该项是否为叶子
+    struct level_cursor {
+        const Huffman *coder;
+        const uint8_t *leaves;
+        const uint64_t *packages;
+        unsigned n, packages_n, i, j;
+
+        bool next(uint64_t &weight, bool &is_leaf) {
+            if (i >= n && j >= packages_n) return false;
+            is_leaf = j >= packages_n || (i < n && coder->symbol_array[leaves[i]].weight <= packages[j]);
+            weight = is_leaf ? coder->symbol_array[leaves[i++]].weight : packages[j++];
+            return true;
+        }
+    };
+
+    for (unsigned l = 1; l < max_bits; l++) {
+        level_cursor prev = { this, leaves, packages[l - 1], n, package_count[l - 1], 0, 0 };
+        unsigned k = 0;
+        uint64_t first, second;
+        bool is_leaf;
+        while (prev.next(first, is_leaf) && prev.next(second, is_leaf)) {
+            packages[l][k++] = first + second;
+        }
+        package_count[l] = k;
+    }
 
-        tmp_vec.push_back(1); // 分配码元 1
-        BuildHuffmanDictInternal(root_node->L_node, (code << 1) + 1, bits + 1, tmp_vec);
-        tmp_vec.push_back(0);  // 分配码元 0
-        BuildHuffmanDictInternal(root_node->R_node, (code << 1) + 0, bits + 1, tmp_vec);
+    // 从最后一层选取前 2n-2 项，其中的包对应上一层的前 2 * 包数 项；
+    // 每层选中的叶子总是排在最前的若干个，每个叶子被选中的层数即为其码长
+    for (unsigned i = 0; i < n; i++) {
+        symbol_array[leaves[i]].bits = 0;
+    }
+    unsigned selected = 2 * n - 2;
+    for (int l = max_bits - 1; l >= 0 && selected; l--) {
+        level_cursor cur = { this, leaves, packages[l], n, package_count[l], 0, 0 };
+        unsigned leaf_count = 0;
+        uint64_t weight;
+        bool is_leaf;
+        for (unsigned k = 0; k < selected && cur.next(weight, is_leaf); k++) {
+            if (is_leaf) leaf_count++;
+        }
+        for (unsigned i = 0; i < leaf_count; i++) {
+            symbol_array[leaves[i]].bits++;
+        }
+        selected = 2 * (selected - leaf_count);
+    }
+}
+
+/**
+ * @brief 按 (码长, 符号) 的顺序依次分配范式霍夫曼码，码长为 0 的符号不分配
+ */
+void Huffman::CanonicalCodes(const uint8_t *bits_arr, uint32_t *code_arr)
+{
+    // 统计各码长的符号个数，码长为 len 的第一个码字 = (码长为 len-1 的第一个码字 + 其个数) << 1
+    uint32_t bl_count[33] = {0};
+    uint64_t next_code[33] = {0};
+    for (unsigned i = 0; i < 256; i++) {
+        bl_count[bits_arr[i]] ++;
+    }
+    bl_count[0] = 0;
+    for (unsigned len = 1; len <= 32; len++) {
+        next_code[len] = (next_code[len - 1] + bl_count[len - 1]) << 1;
     }
 
-    if(!tmp_vec.empty()) {
-        tmp_vec.pop_back();
+    for (unsigned i = 0; i < 256; i++) {
+        if (bits_arr[i]) {
+            code_arr[i] = uint32_t(next_code[bits_arr[i]]++);
+        }
     }
 }
 
 /**
- * @brief 霍夫曼编码的主函数，并把霍夫曼树信息保存到输出流中，该函数调用 BuildHuffmanDictInternal 实现编码
+ * @brief 霍夫曼编码的主函数，码长超过限制时重新构造，再按码长分配范式霍夫曼码
  */
 void Huffman::BuildHuffmanDict()
 {
-    std::vector<char> code_vec;
-    BuildHuffmanDictInternal(huffman_root, 0, 0, code_vec);
+    uint8_t bits_arr[256];
+    uint32_t code_arr[256] = {0};
+
+    // 码长超过最大码长时重新构造，码字为 32 位整型，所以码长最多 32 位
+    uint8_t limit = (max_code_length && max_code_length < 32) ? max_code_length : 32;
+    uint8_t depth = 0;
+    unlimited_ave_length = 0.0;
+    for (unsigned i = 0; i < 256; i++) {
+        unlimited_ave_length += symbol_array[i].freq * symbol_array[i].bits;
+        if (symbol_array[i].bits > depth) depth = symbol_array[i].bits;
+    }
+    if (depth > limit) LimitCodeLengths(limit);
+
+    for (unsigned i = 0; i < 256; i++) {
+        bits_arr[i] = symbol_array[i].bits;
+    }
+    CanonicalCodes(bits_arr, code_arr);
+
+    for (unsigned i = 0; i < 256; i++) {
+        if (symbol_array[i].bits) symbol_array[i].code = code_arr[i];
+    }
+}
+
+/**
+ * @brief 由 symbol_array 中的出现次数构造码长与码字；不足两种符号时补上不出现的符号，使码字构成完备的前缀码
+ */
+void Huffman::BuildCompleteCodes()
+{
+    unsigned kinds = 0, symbol = 0;
+    for (unsigned i = 0; i < 256; i++) {
+        if (symbol_array[i].count) {
+            kinds++;
+            symbol = i;
+        }
+    }
+    if (kinds < 2) {
+        symbol_array[symbol].count += !kinds;
+        symbol_array[symbol ^ 1].count = 1;
+    }
+    BuildCodeLengths();
+    BuildHuffmanDict();
+}
+
+/**
+ * @brief 把各符号的码长写入比特流
+ *        码长表：符号种类数-1 (8位)，最短码长-1 (5位)，码长差值的位宽 (3位)，
+ *        随后对每个出现过的符号写入与前一个符号的差值 (Elias-gamma 编码) 及其码长与最短码长的差值
+ */
+template <class BitWriter>
+void Huffman::WriteCodeLengths(BitWriter &out)
+{
+    unsigned kinds = 0;
+    uint8_t min_bits = 32, max_bits = 0;
+    for (unsigned i = 0; i < 256; i++) {
+        if (symbol_array[i].bits) {
+            kinds ++;
+            if (symbol_array[i].bits < min_bits) min_bits = symbol_array[i].bits;
+            if (symbol_array[i].bits > max_bits) max_bits = symbol_array[i].bits;
+        }
+    }
+    uint8_t width = 0;
+    while ((max_bits - min_bits) >> width) width++;
+
+    out.writbits(kinds - 1, 8);
+    out.writbits(min_bits - 1, 5);
+    out.writbits(width, 3);
+
+    int prev = -1;
+    for (int i = 0; i < 256; i++) {
+        if (symbol_array[i].bits) {
+            // 符号一般集中在一段连续的区间内，差值多为 1，只需 1 位
+            uint32_t gap = i - prev;
+            uint8_t gap_bits = 0;
+            while (gap >> (gap_bits + 1)) gap_bits++;
+            out.writbits(0, gap_bits);
+            out.writbits(gap, gap_bits + 1);
+            out.writbits(symbol_array[i].bits - min_bits, width);
+            prev = i;
+        }
+    }
+}
+
+// 读取码长表时检查输入是否已读完：文件流由 remain_bits 得知；内存中的块没有长度，
+// 块后补的 0 足以容纳最长的码长表，由调用者在读完后检查读取位置
+static inline bool exhausted(const ibitstream &in) { return !in.remain_bits(); }
+static inline bool exhausted(const ibitbuffer &) { return false; }
+static inline bool overrun(const ibitstream &in) { return in.overrun(); }
+static inline bool overrun(const ibitbuffer &) { return false; }
+
+/**
+ * @brief 读取 WriteCodeLengths 写入的码长表，码长表不合法或输入在码长表中途结束时返回 SOURCE_ERR
+ */
+template <class BitReader>
+Huffman::huffman_err Huffman::ReadCodeLengths(BitReader &in, uint8_t *bits_arr)
+{
+    unsigned kinds = in.readbits(8) + 1;
+    uint8_t min_bits = in.readbits(5) + 1;
+    uint8_t width = in.readbits(3);
+    if (width > 5) return SOURCE_ERR;
+
+    int symbol = -1;
+    for (unsigned k = 0; k < kinds; k++) {
+        // 读完之后读到的都是 0，间隔的一元码会一直读下去，须在每个符号前检查
+        if (exhausted(in)) return SOURCE_ERR;
+        uint8_t gap_bits = 0;
+        while (!in.readbits(1)) {
+            if (++gap_bits > 8 || exhausted(in)) return SOURCE_ERR;
+        }
+        symbol += (1 << gap_bits) | in.readbits(gap_bits);
+        if (symbol > 255) return SOURCE_ERR;
+
+        unsigned bits = min_bits + in.readbits(width);
+        if (bits > 32) return SOURCE_ERR;
+        bits_arr[symbol] = bits;
+    }
+    return overrun(in) ? SOURCE_ERR : HUFFMAN_OK;
+}
+
+/**
+ * @brief 把文件格式字节与各符号的码长写入输出流
+ */
+void Huffman::WriteHeader()
+{
+    encode_stream.writbits(stream_count > 1 ? FORMAT_MULTI_STREAM : FORMAT_CANONICAL, 8);
+    WriteCodeLengths(encode_stream);
+
+    // 多子流格式：写入子流个数，并对齐到字节边界，之后的各段均按字节存放
+    if (stream_count > 1) {
+        encode_stream.writbits(stream_count, 8);
+        if (encode_stream.freebits() != 8) encode_stream.writbits(0, encode_stream.freebits());
+    }
 }
 
 void Huffman::Statistics()
@@ -162,25 +477,43 @@ void Huffman::Statistics()
         }
     }
 
-    // 计算编码效率
+    // 计算编码效率，以及限制码长后相对于不限制码长时的效率损失
     efficiency = entropy / ave_length;
+    efficiency_loss = entropy / unlimited_ave_length - efficiency;
 }
 
 Huffman::huffman_err Huffman::Encode(const char filename[])
 {
+    // 源文件不能映射到内存时，读取文件的时间从统计频率中扣除
+    double read_start = stats[PHASE_READ].wall_time;
+    phase_timer timer(stats[PHASE_COUNT]);
+
     if(!GetFreqTable(filename))  return FILE_OPEN_ERR;  // 统计频率
-    if(BuildHuffmanTree() < 2) return SOURCE_ERR;       // 构建霍夫曼树
-    BuildHuffmanDict();                                 // 遍历树进行编码
+    timer.next(stats[PHASE_TREE], char_count, 0, stats[PHASE_READ].wall_time - read_start);
+    if(BuildCodeLengths() < 2) return SOURCE_ERR;       // 构造码长
+    timer.next(stats[PHASE_DICT]);
+    BuildHuffmanDict();                                 // 分配码字
+    timer.next(stats[PHASE_STATISTICS]);
     Statistics();                                       // 统计各项指标
 
     return HUFFMAN_OK;
 }
 
-Huffman::huffman_err Huffman::Encode(std::string usr_str)
+Huffman::huffman_err Huffman::Encode(const std::string &usr_str)
+{
+    return Encode((const uint8_t *)usr_str.data(), usr_str.size());
+}
+
+Huffman::huffman_err Huffman::Encode(const uint8_t *src, size_t len)
 {
-    GetFreqTable(usr_str);                        // 统计频率
-    if(BuildHuffmanTree() < 2) return SOURCE_ERR; // 构建霍夫曼树
-    BuildHuffmanDict();                           // 遍历树进行编码
+    phase_timer timer(stats[PHASE_COUNT]);
+
+    GetFreqTable(src, len);                       // 统计频率
+    timer.next(stats[PHASE_TREE], len);
+    if(BuildCodeLengths() < 2) return SOURCE_ERR; // 构造码长
+    timer.next(stats[PHASE_DICT]);
+    BuildHuffmanDict();                           // 分配码字
+    timer.next(stats[PHASE_STATISTICS]);
     Statistics();                                 // 统计各项指标
 
     return HUFFMAN_OK;
@@ -188,11 +521,90 @@ Huffman::huffman_err Huffman::Encode(std::string usr_str)
 
 Huffman::huffman_err Huffman::compress(const char *src_file, const char *dst_file)
 {
-    // 创建压缩后的文件
-    if(!encode_stream.open(dst_file)) return DST_ERR;
+    double read_start = stats[PHASE_READ].wall_time;
+    phase_timer timer(stats[PHASE_ENCODE]);
+    huffman_err err = CompressFile(src_file, dst_file);
+    StopEncodeTimer(timer, read_start, char_count);
+
+    return err;
+}
+
+/**
+ * @brief 压缩文件，由 compress(const char *, const char *) 计时后调用
+ */
+Huffman::huffman_err Huffman::CompressFile(const char *src_file, const char *dst_file)
+{
+    // 创建压缩后的文件，流水线方式下由写线程写出
+    ofstream outfile;
+    unique_ptr<writebehind_ostream> writer;
+    if(pipeline) {
+        outfile.open(dst_file, ofstream::out | ofstream::binary);
+        if(!outfile) return DST_ERR;
+        writer.reset(new writebehind_ostream(outfile));
+        encode_stream.open(*writer);
+    } else if(!encode_stream.open(dst_file)) return DST_ERR;
+
+    // 源文件能映射到内存时直接编码映射的数据，否则按块读取，流水线方式下由读线程预读
+    huffman_err err;
+    mapped_file mapped;
+    if(!pipeline && mapped.open(src_file)) {
+        err = CompressMemory(mapped.data(), mapped.size());
+    } else {
+        ifstream infile(src_file, ifstream::in | ifstream::binary);
+        if(infile) {
+            unique_ptr<prefetch_istream> prefetch(pipeline ? new prefetch_istream(infile) : nullptr);
+            istream &input = prefetch ? *prefetch : static_cast<istream &>(infile);
+            err = CompressInput(input);
+            // 读文件出错时输入流置 badbit（流水线方式下由读线程出错），不能当作读到末尾
+            if(err == HUFFMAN_OK && input.bad()) err = SOURCE_ERR;
+        } else err = FILE_OPEN_ERR;
+    }
+
+    // 关闭时刷新输出，写文件出错（流水线方式下由写线程出错）时返回 DST_ERR
+    encode_stream.close();
+    if(err == HUFFMAN_OK && encode_stream.failed()) err = DST_ERR;
+    return err;
+}
+
+/**
+ * @brief 编码输入流中的全部数据并写入 encode_stream，由 CompressFile 打开文件后调用
+ */
+Huffman::huffman_err Huffman::CompressInput(std::istream &input)
+{
+    // 使用码本与上下文模型时需事先知道符号个数，整个读入后再编码
+    if(codebook || context_tables > 1) {
+        vector<uint8_t> data;
+        uint8_t buffer[65536];
+        while(input) {
+            size_t n = ReadInput(input, buffer, sizeof(buffer));
+            data.insert(data.end(), buffer, buffer + n);
+        }
+        return CompressMemory(data.data(), data.size());
+    }
+
+    // 分块格式：按块读取源文件，各块并行编码
+    if(block_size) {
+        CompressBlocks([this, &input](uint8_t *dst, uint32_t len) -> uint32_t {
+            return ReadInput(input, dst, len);
+        });
+        return HUFFMAN_OK;
+    }
+
+    // 写入文件头
+    WriteHeader();
+
+    // 多子流格式：按段读取源文件，每段单独编码
+    if(stream_count > 1) {
+        vector<char> segment(HUFFMAN_SEGMENT_LENGTH);
+        while(input) {
+            size_t n = ReadInput(input, (uint8_t *)&segment[0], HUFFMAN_SEGMENT_LENGTH);
+            if(n) EncodeSegment((uint8_t *)&segment[0], n);
+        }
+        return HUFFMAN_OK;
+    }
 
     // 计算在文件最后需要补多少个0
-    uint8_t last_bits = (11 - encode_stream.freebits) % 8;
+    uint8_t last_bits = (11 - encode_stream.freebits()) % 8;
     for (unsigned i = 0; i < 256; i++) {
         last_bits = (last_bits + symbol_array[i].count * symbol_array[i].bits) % 8;
     }
@@ -200,22 +612,23 @@ Huffman::huffman_err Huffman::compress(const char *src_file, const char *dst_fil
         encode_stream.writbits(8 - last_bits, 3);
     } else encode_stream.writbits(0, 3);
 
-    // 打开源文件，逐字节进行压缩
-    char buffer[65536];
-    uint8_t symbol;
-    ifstream infile(src_file, ifstream::in | ifstream::binary);
-    if(infile) {
-        do {
-            unsigned i;
-            infile.read((char *)buffer, 65536);
-            for (i = 0; i < infile.gcount(); i++) {
-                symbol = buffer[i];
-                encode_stream.writbits(symbol_array[symbol].code, symbol_array[symbol].bits);
-            }
-        } while (infile);
-        infile.close();
+    // 数据量较大时按段读取源文件，每段由线程池并行编码
+    if(resolve_threads(thread_count) > 1 && char_count >= HUFFMAN_PARALLEL_MIN_LENGTH) {
+        thread_pool pool(thread_count);
+        vector<char> segment(HUFFMAN_PARALLEL_SEGMENT);
+        while(input) {
+            size_t n = ReadInput(input, (uint8_t *)&segment[0], HUFFMAN_PARALLEL_SEGMENT);
+            if(n) EncodeParallel((uint8_t *)&segment[0], n, pool);
+        }
+        return HUFFMAN_OK;
     }
-    encode_stream.close();
+
+    // 逐块进行压缩
+    char buffer[65536];
+    do {
+        size_t n = ReadInput(input, (uint8_t *)buffer, 65536);
+        EncodeSymbols((uint8_t *)buffer, n);
+    } while (input);
 
     return HUFFMAN_OK;
 }
@@ -225,8 +638,125 @@ Huffman::huffman_err Huffman::compress(std::string &src_str, const char *dst_fil
     // 创建压缩后的文件
     if (!encode_stream.open(dst_file)) return DST_ERR;
 
+    phase_timer timer(stats[PHASE_ENCODE]);
+    huffman_err err = CompressMemory((const uint8_t *)src_str.data(), src_str.size());
+    encode_stream.close();
+    if(err == HUFFMAN_OK && encode_stream.failed()) err = DST_ERR;
+    StopEncodeTimer(timer, stats[PHASE_READ].wall_time, src_str.size());
+
+    return err;
+}
+
+Huffman::huffman_err Huffman::compress(const uint8_t *src, size_t len, std::vector<uint8_t> &dst)
+{
+    phase_timer timer(stats[PHASE_ENCODE]);
+    encode_stream.open(dst);
+    huffman_err err = CompressMemory(src, len);
+    encode_stream.close();
+    StopEncodeTimer(timer, stats[PHASE_READ].wall_time, len);
+
+    return err;
+}
+
+Huffman::huffman_err Huffman::compress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_capacity, size_t &dst_len)
+{
+    phase_timer timer(stats[PHASE_ENCODE]);
+    encode_stream.open(dst, dst_capacity);
+    huffman_err err = CompressMemory(src, len);
+    encode_stream.close();
+    StopEncodeTimer(timer, stats[PHASE_READ].wall_time, len);
+
+    dst_len = encode_stream.size();
+    if (err == HUFFMAN_OK && encode_stream.overflow()) err = DST_ERR;
+    return err;
+}
+
+size_t Huffman::compress_bound(size_t len) const
+{
+    // 码长表：16 位的表头，每个符号的差值不超过 17 位、码长差不超过 5 位
+    const size_t header = 2 + 256 * 22 / 8;
+
+    // 码本中样本里少见的符号码字可能很长，按码本的最大码长计算
+    if (codebook) {
+        map<uint32_t, codebook_t>::const_iterator it = codebooks.find(codebook);
+        uint8_t max_bits = 32;
+        if (it != codebooks.end()) max_bits = *max_element(it->second.bits, it->second.bits + 256);
+        // 格式字节，码本 ID 与符号个数，编码数据
+        return 1 + 5 + 10 + (uint64_t(len) * max_bits + 7) / 8;
+    }
+
+    // 等长的 8 位码也是前缀码，因此霍夫曼码（包括限制码长后的最优码长）编码每个符号平均不超过 8 位；
+    // 上下文模型中每组的码表由该组实际编码的符号构造，同样成立
+    if (context_tables > 1) {
+        size_t groups = min<size_t>(context_tables, HUFFMAN_MAX_CONTEXTS);
+        // 格式字节，组数，各前一字节所属的组，各组的码长表，符号个数，末尾不满的字节
+        return 1 + 1 + 256 + groups * header + 8 + len + 1;
+    }
+    if (block_size) {
+        size_t size = min<size_t>(block_size, HUFFMAN_MAX_BLOCK_SIZE);
+        size_t blocks = (len + size - 1) / size;
+        // 格式字节，各块的块头、码长表、末尾不满的字节与索引项，结束块头，块数与标识
+        return 1 + len + blocks * (8 + header + 1 + 24) + 8 + 8;
+    }
+    if (stream_count > 1) {
+        size_t segments = (len + HUFFMAN_SEGMENT_LENGTH - 1) / HUFFMAN_SEGMENT_LENGTH;
+        // 格式字节，码长表，子流个数与对齐，各段的段头与各子流末尾不满的字节
+        return 1 + header + 2 + len + segments * (4 + 5 * size_t(stream_count));
+    }
+    // 格式字节，码长表，3 位的补 0 个数与末尾不满的字节
+    return 1 + header + 1 + len;
+}
+
+/**
+ * @brief 压缩内存中的数据，写入已打开的 encode_stream
+ */
+Huffman::huffman_err Huffman::CompressMemory(const uint8_t *src, size_t len)
+{
+    // 使用码本：不统计频率、不写码长表，只写码本 ID 与符号个数
+    if (codebook) {
+        map<uint32_t, codebook_t>::const_iterator it = codebooks.find(codebook);
+        if (it == codebooks.end()) return SOURCE_ERR;
+        char_count = len;
+        encode_stream.writbits(FORMAT_CODEBOOK, 8);
+        write_varint(encode_stream, codebook);
+        write_varint(encode_stream, len);
+        // 直接使用码本中的码表，symbol_array 仍保留 Encode 统计构造的码表，之后不用码本时照常压缩
+        EncodeSymbols(src, len, it->second);
+        return HUFFMAN_OK;
+    }
+
+    // 一阶上下文模型：码表由本次的数据构造，写在文件头中
+    if (context_tables > 1) {
+        char_count = len;
+        EncodeContext(src, len);
+        return HUFFMAN_OK;
+    }
+
+    // 分块格式
+    if (block_size) {
+        size_t pos = 0;
+        CompressBlocks([src, len, &pos](uint8_t *dst, uint32_t n) -> uint32_t {
+            if (n > len - pos) n = len - pos;
+            memcpy(dst, src + pos, n);
+            pos += n;
+            return n;
+        });
+        return HUFFMAN_OK;
+    }
+
+    // 写入文件头
+    WriteHeader();
+
+    // 多子流格式：按段编码
+    if (stream_count > 1) {
+        for (size_t i = 0; i < len; i += HUFFMAN_SEGMENT_LENGTH) {
+            EncodeSegment(src + i, min<size_t>(len - i, HUFFMAN_SEGMENT_LENGTH));
+        }
+        return HUFFMAN_OK;
+    }
+
     // 计算在文件最后需要补多少个0
-    uint8_t last_bits = (11 - encode_stream.freebits) % 8;
+    uint8_t last_bits = (11 - encode_stream.freebits()) % 8;
     for (unsigned i = 0; i < 256; i++) {
         last_bits = (last_bits + symbol_array[i].count * symbol_array[i].bits) % 8;
     }
@@ -234,75 +764,1421 @@ Huffman::huffman_err Huffman::compress(std::string &src_str, const char *dst_fil
         encode_stream.writbits(8 - last_bits, 3);
     } else encode_stream.writbits(0, 3);
 
-    // 逐字节进行压缩
-    uint8_t symbol;
-    for (unsigned i = 0; i < char_count; i++) {
-        symbol = src_str[i];
-        encode_stream.writbits(symbol_array[symbol].code, symbol_array[symbol].bits);
+    // 数据量较大时按段由线程池并行编码
+    if (resolve_threads(thread_count) > 1 && len >= HUFFMAN_PARALLEL_MIN_LENGTH) {
+        thread_pool pool(thread_count);
+        for (size_t i = 0; i < len; i += HUFFMAN_PARALLEL_SEGMENT) {
+            EncodeParallel(src + i, min<size_t>(len - i, HUFFMAN_PARALLEL_SEGMENT), pool);
+        }
+        return HUFFMAN_OK;
     }
-    encode_stream.close();
 
+    // 进行压缩
+    EncodeSymbols(src, len);
     return HUFFMAN_OK;
 }
 
-void Huffman::RecoverTree(ibitstream &decode_stream, decode_tree_node *node)
+Huffman::huffman_err Huffman::compress(std::istream &src, std::ostream &dst)
 {
-    if(decode_stream.readbit()) {
-        node->symbol = decode_stream.read8bits();
-        return;
+    if (!dst) return DST_ERR;
+
+    double read_start = stats[PHASE_READ].wall_time;
+    phase_timer timer(stats[PHASE_ENCODE]);
+
+    // 流水线方式下由读线程预读、写线程写出，写线程在函数返回前结束
+    unique_ptr<prefetch_istream> prefetch(pipeline ? new prefetch_istream(src) : nullptr);
+    unique_ptr<writebehind_ostream> writer(pipeline ? new writebehind_ostream(dst) : nullptr);
+    istream &input = prefetch ? *prefetch : src;
+    ostream &output = writer ? *writer : dst;
+
+    // 按自适应格式流式编码，每读入一块就取出已产生的输出
+    huffman_encoder encoder(max_code_length);
+    vector<uint8_t> in(HUFFMAN_ADAPTIVE_SEGMENT), out(HUFFMAN_STREAM_BACKLOG);
+    uint64_t out_len = 0;
+    double write_time = 0.0;
+    auto drain = [&]() {
+        while (size_t n = encoder.pull(&out[0], out.size())) {
+            double start = wall_clock();
+            output.write((const char *)&out[0], n);
+            write_time += wall_clock() - start;
+            out_len += n;
+        }
+    };
+    while (input) {
+        size_t len = ReadInput(input, &in[0], in.size()), used = 0;
+        while (used < len) {
+            used += encoder.push(&in[used], len - used);
+            drain();
+        }
     }
+    encoder.finish();
+    drain();
+    double start = wall_clock();
+    output.flush();
+    write_time += wall_clock() - start;
+    char_count = encoder.total_in();
 
-    node->L_node = new decode_tree_node();
-    RecoverTree(decode_stream, node->L_node);
+    stats[PHASE_WRITE].add(write_time, 0.0, 0, out_len);
+    timer.stop(char_count, out_len, stats[PHASE_READ].wall_time - read_start + write_time);
 
-    node->R_node = new decode_tree_node();
-    RecoverTree(decode_stream, node->R_node);
+    // 读出错时输入流置 badbit，写出错时输出流置 badbit；流水线方式下读线程、写线程的错误也由此报告
+    if (input.bad()) return SOURCE_ERR;
+    return output ? HUFFMAN_OK : DST_ERR;
 }
 
-Huffman::huffman_err Huffman::decompress(const char *src_file, const char *dst_file)
+/**
+ * @brief 把一段数据逐个符号编码写入 encode_stream，lookup(c, code, bits) 给出符号 c 的码字与码长
+ */
+template <class Lookup>
+void Huffman::EncodeBatched(const uint8_t *src, size_t len, Lookup lookup)
 {
-    // 打开待解压的文件
-    ibitstream decode_stream;
-    if(!decode_stream.open(src_file)) return SOURCE_ERR;
-
-    // 创建解压后的文件
-    obitstream decompress_stream;
-    if(!decompress_stream.open(dst_file)) return DST_ERR;
+    // 先成批查出各符号的码字与码长，再一次写入
+    uint32_t codes[HUFFMAN_ENCODE_BATCH];
+    uint8_t bits[HUFFMAN_ENCODE_BATCH];
+    while (len) {
+        size_t n = len < HUFFMAN_ENCODE_BATCH ? len : HUFFMAN_ENCODE_BATCH;
+        for (size_t i = 0; i < n; i++) {
+            lookup(src[i], codes[i], bits[i]);
+        }
+        encode_stream.writbits(codes, bits, n);
+        src += n;
+        len -= n;
+    }
+}
 
-    // 从文件头部信息中重建霍夫曼树
-    decode_tree_node root_node;
-    RecoverTree(decode_stream, &root_node);
+/**
+ * @brief 把一段数据逐个符号编码写入 encode_stream
+ */
+void Huffman::EncodeSymbols(const uint8_t *src, size_t len)
+{
+    EncodeBatched(src, len, [this](uint8_t c, uint32_t &code, uint8_t &bits) {
+        code = symbol_array[c].code;
+        bits = symbol_array[c].bits;
+    });
+}
 
-    // 读取文件末尾补的0的个数
-    uint8_t zero_padding;
-    zero_padding = decode_stream.readbit() << 2;
-    zero_padding |= decode_stream.readbit() << 1;
-    zero_padding |= decode_stream.readbit();
+void Huffman::EncodeSymbols(const uint8_t *src, size_t len, const codebook_t &book)
+{
+    EncodeBatched(src, len, [&book](uint8_t c, uint32_t &code, uint8_t &bits) {
+        code = book.code[c];
+        bits = book.bits[c];
+    });
+}
 
-    // 解压缩
-    decode_tree_node *node;
-    while(decode_stream.remain_bits > zero_padding) {
-        node = &root_node;
-        while(node->L_node && node->R_node) {
-            node = decode_stream.readbit() ? node->L_node : node->R_node;
+/**
+ * @brief 把一段数据按符号交错编码到 stream_count 个子流中，连同段头一起写入输出流
+ */
+void Huffman::EncodeSegment(const uint8_t *src, uint32_t len)
+{
+    obitbuffer streams[HUFFMAN_MAX_STREAMS];
+    uint32_t i = 0;
+    for (; i + stream_count <= len; i += stream_count) {
+        for (unsigned s = 0; s < stream_count; s++) {
+            const symbol_t &sym = symbol_array[src[i + s]];
+            streams[s].writbits(sym.code, sym.bits);
         }
-        decompress_stream.writbyte((uint8_t)(node->symbol));
+    }
+    for (unsigned s = 0; i < len; i++, s++) {
+        streams[s].writbits(symbol_array[src[i]].code, symbol_array[src[i]].bits);
     }
 
-    decompress_stream.close();
-    decode_stream.close();
+    // 段头按字节写入，各整数均为高字节在前
+    obitbuffer head;
+    head.writbits(len, 32);
+    for (unsigned s = 0; s < stream_count; s++) {
+        streams[s].flush();
+        head.writbits(streams[s].data.size(), 32);
+    }
+    encode_stream.writbytes(head.data.data(), head.data.size());
+    for (unsigned s = 0; s < stream_count; s++) {
+        encode_stream.writbytes(streams[s].data.data(), streams[s].data.size());
+    }
+}
+
+/**
+ * @brief 依次读取 EncodeSegment 写入的各段，解码各子流并按原顺序写入输出流
+ */
+Huffman::huffman_err Huffman::DecodeStreams(ibitstream &decode_stream, obitstream &decompress_stream,
+                                            const decode_table &table, uint8_t streams, uint8_t max_bits)
+{
+    vector<uint8_t> data, symbols;
+    ibitbuffer readers[HUFFMAN_MAX_STREAMS];
+    uint32_t sizes[HUFFMAN_MAX_STREAMS];
+    uint32_t offsets[HUFFMAN_MAX_STREAMS];
+    uint8_t head[4 * (HUFFMAN_MAX_STREAMS + 1)];
+
+    while(decode_stream.remain_bits()) {
+        // 读取段头
+        if(!decode_stream.readbytes(head, 4 * (streams + 1))) return SOURCE_ERR;
+        uint32_t count = load_be32(head);
+        if(count > HUFFMAN_SEGMENT_LENGTH) return SOURCE_ERR;
+
+        // 第 s 个子流编码 count / streams 或再多一个符号，字节数不超过这些符号都取最大码长时的字节数
+        uint32_t total = 0;
+        for (unsigned s = 0; s < streams; s++) {
+            sizes[s] = load_be32(head + 4 * (s + 1));
+            uint64_t symbols_s = count / streams + (s < count % streams);
+            if(sizes[s] > (symbols_s * max_bits + 7) / 8) return SOURCE_ERR;
+            total += sizes[s];
+        }
+
+        // 每个符号最多 32 位，末尾补足 0 可保证损坏的数据也不会使子流读出缓冲区
+        data.assign(total + (count / streams + 1) * 4 + BIT_STREAM_PADDING, 0);
+        if(!decode_stream.readbytes(&data[0], total)) return SOURCE_ERR;
+        for (unsigned s = 0, offset = 0; s < streams; offset += sizes[s], s++) {
+            offsets[s] = offset;
+            readers[s].open(&data[offset]);
+        }
+
+        // 各子流互不依赖，同一轮循环中依次解码，CPU 可以同时执行多个子流的查表
+        symbols.resize(count);
+        uint32_t k = 0;
+        for (; k + streams <= count; k += streams) {
+            for (unsigned s = 0; s < streams; s++) {
+                symbols[k + s] = table.decode(readers[s]);
+            }
+        }
+        for (unsigned s = 0; k < count; k++, s++) {
+            symbols[k] = table.decode(readers[s]);
+        }
 
+        // 子流读出了本身的范围，说明数据被截断或损坏
+        for (unsigned s = 0; s < streams; s++) {
+            if(readers[s].tell(&data[offsets[s]]) > uint64_t(sizes[s]) * 8) return SOURCE_ERR;
+        }
+        decompress_stream.writbytes(symbols.data(), count);
+    }
     return HUFFMAN_OK;
 }
 
-void Huffman::ShowResult()
+/**
+ * @brief 多线程编码一段数据并写入 encode_stream，结果与逐个符号调用 writbits 完全相同
+ */
+void Huffman::EncodeParallel(const uint8_t *src, size_t len, thread_pool &pool)
 {
-    char  line[] = "+-------------+---------+-----------------+-------------+----------------------------+";
-    char title[] = "|   Symbol    |  Count  |    Frequency    | Code Length |            Code            |";
-    char c7_13[][6] = { "\\a'  ", "\\b'  ", "\\t'  ", "\\n'  ", "\\v'  ", "\\f'  ", "\\r'  "};
-    char symbol;
+    unsigned parts = pool.size();
+    size_t part_len = (len + parts - 1) / parts;
+    vector<const uint8_t *> part_src(parts);
+    vector<size_t> part_size(parts);
+    for (unsigned t = 0; t < parts; t++) {
+        size_t begin = min(len, t * part_len);
+        part_src[t] = src + begin;
+        part_size[t] = min(part_len, len - begin);
+    }
 
-    cout << line << endl;
+    // 由各符号的码长算出每部分编码后的比特数
+    vector< future<uint64_t> > lengths;
+    for (unsigned t = 0; t < parts; t++) {
+        lengths.push_back(pool.submit([this, &part_src, &part_size, t]() -> uint64_t {
+            histogram hist;
+            hist.add(part_src[t], part_size[t]);
+            uint64_t bits = 0;
+            for (unsigned i = 0; i < 256; i++) {
+                bits += hist[i] * symbol_array[i].bits;
+            }
+            return bits;
+        }));
+    }
+
+    // 前缀和即为各部分的起始位置，从当前未写满字节中已占用的位算起，使其与输出流的字节边界一致
+    vector<uint64_t> start(parts + 1);
+    start[0] = 8 - encode_stream.freebits();
+    for (unsigned t = 0; t < parts; t++) {
+        start[t + 1] = start[t] + lengths[t].get();
+    }
+
+    // 各线程把码字直接写入共享的输出缓冲区；每部分的第一个字节与最后不满的字节可能与相邻部分共用，单独保存后再合并
+    vector<uint8_t> out(start[parts] / 8 + 1, 0);
+    vector<uint8_t> head(parts, 0), tail(parts, 0);
+    vector< future<void> > done;
+    for (unsigned t = 0; t < parts; t++) {
+        done.push_back(pool.submit([this, &part_src, &part_size, &start, &out, &head, &tail, t]() {
+            uint64_t first = start[t] >> 3, pos = first;
+            uint64_t acc = 0;
+            uint8_t nbits = start[t] & 7;
+            for (size_t i = 0; i < part_size[t]; i++) {
+                const symbol_t &s = symbol_array[part_src[t][i]];
+                acc = (acc << s.bits) | s.code;
+                nbits += s.bits;
+                while (nbits >= 8) {
+                    nbits -= 8;
+                    if (pos == first) head[t] = uint8_t(acc >> nbits);
+                    else out[pos] = uint8_t(acc >> nbits);
+                    pos++;
+                }
+            }
+            if (nbits) {
+                if (pos == first) head[t] = uint8_t(acc << (8 - nbits));
+                else tail[t] = uint8_t(acc << (8 - nbits));
+            }
+        }));
+    }
+    for (future<void> &f : done) f.get();
+
+    for (unsigned t = 0; t < parts; t++) {
+        out[start[t] >> 3] |= head[t];
+        out[start[t + 1] >> 3] |= tail[t];
+    }
+    encode_stream.writshifted(&out[0], start[parts]);
+}
+
+/**
+ * @brief 对一块数据单独统计频率、构造码表并编码，结果写入 out
+ */
+void Huffman::EncodeBlock(const uint8_t *src, uint32_t len, vector<uint8_t> &out)
+{
+    GetFreqTable(src, len);
+    BuildCompleteCodes();
+
+    // 先空出块头的 8 个字节，编码完成后再填入压缩后的字节数
+    obitbuffer block;
+    block.writbits(0, 32);
+    block.writbits(len, 32);
+    WriteCodeLengths(block);
+    for (uint32_t i = 0; i < len; i++) {
+        block.writbits(symbol_array[src[i]].code, symbol_array[src[i]].bits);
+    }
+    block.flush();
+
+    store_be32(&block.data[0], block.data.size() - 8);
+    out.swap(block.data);
+}
+
+/**
+ * @brief 分块压缩：各块在线程池中并行编码，按顺序写入输出流
+ */
+void Huffman::CompressBlocks(function<uint32_t(uint8_t *, uint32_t)> read)
+{
+    uint32_t size = block_size < HUFFMAN_MAX_BLOCK_SIZE ? block_size : HUFFMAN_MAX_BLOCK_SIZE;
+    encode_stream.writbits(FORMAT_BLOCK, 8);
+
+    // 同时在途的块数有上限，以限制内存占用
+    thread_pool pool(thread_count);
+    deque< future< vector<uint8_t> > > pending;
+    uint8_t limit = max_code_length;
+
+    // 写出各块时记录其位置，最后写入块索引
+    vector<block_index_t> index;
+    uint64_t src_offset = 1, dst_offset = 0;
+    auto write_block = [&](const vector<uint8_t> &out) {
+        uint32_t len = load_be32(&out[4]);
+        index.push_back(block_index_t{src_offset, dst_offset, uint32_t(out.size()), len});
+        src_offset += out.size();
+        dst_offset += len;
+        encode_stream.writbytes(out.data(), out.size());
+    };
+
+    while (true) {
+        shared_ptr< vector<uint8_t> > src = make_shared< vector<uint8_t> >(size);
+        uint32_t len = read(src->data(), size);
+        if (!len) break;
+        src->resize(len);
+
+        pending.push_back(pool.submit([src, limit]() {
+            Huffman coder;
+            coder.max_code_length = limit;
+            coder.thread_count = 1;     // 已在线程池中，块内不再并行统计
+            vector<uint8_t> out;
+            coder.EncodeBlock(src->data(), src->size(), out);
+            return out;
+        }));
+
+        if (pending.size() >= 2 * pool.size()) {
+            write_block(pending.front().get());
+            pending.pop_front();
+        }
+    }
+
+    while (!pending.empty()) {
+        write_block(pending.front().get());
+        pending.pop_front();
+    }
+
+    // 结束块头与块索引
+    vector<uint8_t> tail(8 + index.size() * 24 + 8, 0);
+    uint8_t *p = &tail[8];
+    for (const block_index_t &item : index) {
+        store_be64(p, item.src_offset);
+        store_be64(p + 8, item.dst_offset);
+        store_be32(p + 16, item.src_len);
+        store_be32(p + 20, item.dst_len);
+        p += 24;
+    }
+    store_be32(p, index.size());
+    store_be32(p + 4, HUFFMAN_INDEX_MAGIC);
+    encode_stream.writbytes(tail.data(), tail.size());
+}
+
+/**
+ * @brief 解码一块数据
+ */
+Huffman::huffman_err Huffman::DecodeBlock(const uint8_t *block, uint32_t block_len, uint8_t *dst, uint32_t dst_len)
+{
+    ibitbuffer in;
+    in.open(block);
+
+    uint8_t bits_arr[256] = {0};
+    uint32_t code_arr[256] = {0};
+    decode_table table;
+    if (ReadCodeLengths(in, bits_arr) != HUFFMAN_OK) return SOURCE_ERR;
+    CanonicalCodes(bits_arr, code_arr);
+    if (in.position() > block + block_len || !table.build(code_arr, bits_arr)) return SOURCE_ERR;
+
+    // 分组解码，每组结束后检查是否读出了块的范围
+    const uint8_t *end = block + block_len;
+    for (uint32_t i = 0; i < dst_len; ) {
+        uint32_t n = dst_len - i < HUFFMAN_DECODE_CHUNK ? dst_len - i : HUFFMAN_DECODE_CHUNK;
+        for (uint32_t j = 0; j < n; j++, i++) {
+            dst[i] = table.decode(in);
+        }
+        if (in.position() > end) return SOURCE_ERR;
+    }
+    return HUFFMAN_OK;
+}
+
+/**
+ * @brief 依次读取 CompressBlocks 写入的各块，解码后写入输出流
+ */
+Huffman::huffman_err Huffman::DecompressBlocks(ibitstream &decode_stream, obitstream &decompress_stream)
+{
+    vector<uint8_t> block, out;
+    uint8_t head[8];
+
+    while(decode_stream.remain_bits()) {
+        // 块头：压缩后的字节数，原始字节数
+        if(!decode_stream.readbytes(head, 8)) return SOURCE_ERR;
+        uint32_t block_len = load_be32(head);
+        uint32_t len = load_be32(head + 4);
+        if(!len && !block_len) return HUFFMAN_OK;   // 结束块头，其后为块索引
+        if(!len || len > HUFFMAN_MAX_BLOCK_SIZE || block_len > len * 4u + 1024) return SOURCE_ERR;
+
+        block.assign(block_len + HUFFMAN_BLOCK_PADDING, 0);
+        out.resize(len);
+        if(!decode_stream.readbytes(block.data(), block_len)) return SOURCE_ERR;
+        if(DecodeBlock(block.data(), block_len, out.data(), len) != HUFFMAN_OK) return SOURCE_ERR;
+        decompress_stream.writbytes(out.data(), len);
+    }
+    // 没有读到结束块头，数据被截断
+    return SOURCE_ERR;
+}
+
+/**
+ * @brief 读取分块格式文件末尾的块索引
+ */
+bool Huffman::ReadBlockIndex(const char *src_file, vector<block_index_t> &index)
+{
+    ifstream infile(src_file, ifstream::in | ifstream::binary);
+    if(!infile) return false;
+
+    infile.seekg(0, infile.end);
+    uint64_t file_len = infile.tellg();
+    if(file_len < 1 + 8 + 8) return false;
+
+    uint8_t footer[8];
+    infile.seekg(file_len - 8);
+    infile.read((char *)footer, 8);
+    uint32_t count = load_be32(footer);
+    if(!infile || load_be32(footer + 4) != HUFFMAN_INDEX_MAGIC) return false;
+    if(uint64_t(count) * 24 > file_len - 1 - 8 - 8) return false;
+
+    vector<uint8_t> buffer(count * 24);
+    uint64_t index_offset = file_len - 8 - buffer.size();
+    infile.seekg(index_offset);
+    infile.read((char *)buffer.data(), buffer.size());
+    if(!infile) return false;
+
+    // 各块在压缩文件中依次相连，原始偏移与长度也必须首尾衔接
+    index.resize(count);
+    uint64_t src_offset = 1, dst_offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *p = &buffer[i * 24];
+        block_index_t &item = index[i];
+        item.src_offset = load_be64(p);
+        item.dst_offset = load_be64(p + 8);
+        item.src_len = load_be32(p + 16);
+        item.dst_len = load_be32(p + 20);
+        if(item.src_offset != src_offset || item.dst_offset != dst_offset || item.src_len < 8 ||
+           !item.dst_len || item.dst_len > HUFFMAN_MAX_BLOCK_SIZE) return false;
+        src_offset += item.src_len;
+        dst_offset += item.dst_len;
+    }
+    return src_offset + 8 == index_offset;
+}
+
+/**
+ * @brief 根据块索引在线程池中并行解码各块，每块直接写到其在解压文件中的位置
+ */
+Huffman::huffman_err Huffman::DecompressBlocksParallel(const char *src_file, const char *dst_file,
+                                                       const vector<block_index_t> &index)
+{
+    thread_pool pool(thread_count);
+    vector< future<huffman_err> > results;
+
+    for (const block_index_t &item : index) {
+        results.push_back(pool.submit([src_file, dst_file, item]() -> huffman_err {
+            // 每个任务各自打开文件，读写位置互不影响
+            ifstream infile(src_file, ifstream::in | ifstream::binary);
+            vector<uint8_t> block(item.src_len + HUFFMAN_BLOCK_PADDING, 0);
+            infile.seekg(item.src_offset);
+            infile.read((char *)block.data(), item.src_len);
+            if(!infile) return SOURCE_ERR;
+
+            uint32_t block_len = load_be32(&block[0]);
+            if(block_len != item.src_len - 8 || load_be32(&block[4]) != item.dst_len) return SOURCE_ERR;
+
+            vector<uint8_t> out(item.dst_len);
+            if(DecodeBlock(&block[8], block_len, out.data(), item.dst_len) != HUFFMAN_OK) return SOURCE_ERR;
+
+            fstream outfile(dst_file, fstream::in | fstream::out | fstream::binary);
+            outfile.seekp(item.dst_offset);
+            outfile.write((char *)out.data(), item.dst_len);
+            return outfile ? HUFFMAN_OK : DST_ERR;
+        }));
+    }
+
+    huffman_err err = HUFFMAN_OK;
+    for (future<huffman_err> &result : results) {
+        huffman_err e = result.get();
+        if(err == HUFFMAN_OK) err = e;
+    }
+    return err;
+}
+
+bool Huffman::RecoverTree(ibitstream &decode_stream, decode_tree_node *node, uint8_t depth)
+{
+    // 读完之后读到的都是 0，会一直向左下递归，须检查剩余位数与树的深度
+    if(depth > 32 || !decode_stream.remain_bits()) return false;
+    if(decode_stream.readbit()) {
+        node->symbol = decode_stream.read8bits();
+        return !decode_stream.overrun();
+    }
+
+    node->L_node = new decode_tree_node();
+    if(!RecoverTree(decode_stream, node->L_node, depth + 1)) return false;
+
+    node->R_node = new decode_tree_node();
+    return RecoverTree(decode_stream, node->R_node, depth + 1);
+}
+
+bool Huffman::RecoverCodes(decode_tree_node *node, uint32_t code, uint8_t bits, uint32_t *code_arr, uint8_t *bits_arr)
+{
+    if(!node->L_node && !node->R_node) {
+        code_arr[uint8_t(node->symbol)] = code;
+        bits_arr[uint8_t(node->symbol)] = bits;
+        return true;
+    }
+    if(bits >= 32) return false;
+
+    // 与旧版本的编码器一致：左子树分配码元 1，右子树分配码元 0
+    return RecoverCodes(node->L_node, (code << 1) + 1, bits + 1, code_arr, bits_arr) &&
+           RecoverCodes(node->R_node, (code << 1) + 0, bits + 1, code_arr, bits_arr);
+}
+
+/**
+ * @brief 从 data 的第 begin 位开始解码，直到某个符号的结束位置不小于 bound
+ */
+void Huffman::DecodeSpeculativeChunk(const uint8_t *data, uint64_t begin, uint64_t bound,
+                                     const decode_table &table, bool multi, speculative_chunk_t &chunk)
+{
+    ibitbuffer in;
+    in.open(data, begin);
+    uint64_t pos = begin;
+
+    // 每个符号至少 1 位，解出的符号不会超过段内的位数
+    chunk.symbols.resize(bound - begin + DECODE_MULTI_SYMBOLS);
+    chunk.starts.clear();
+    uint8_t *out = &chunk.symbols[0];
+
+    // 前 HUFFMAN_SYNC_WINDOW 个符号逐个解码并记录起始位置，供校验时寻找同步点
+    while (pos < bound && chunk.starts.size() < HUFFMAN_SYNC_WINDOW) {
+        chunk.starts.push_back(pos);
+        *out++ = table.decode(in);
+        pos = in.tell(data);
+    }
+
+    if (multi) {
+        while (pos + DECODE_TABLE_BITS <= bound) {
+            out += table.decode_multi(in, out);
+            pos = in.tell(data);
+        }
+    }
+    while (pos < bound) {
+        *out++ = table.decode(in);
+        pos = in.tell(data);
+    }
+
+    chunk.symbols.resize(out - &chunk.symbols[0]);
+    chunk.end = pos;
+}
+
+Huffman::huffman_err Huffman::DecodeSpeculative(ibitstream &decode_stream, obitstream &decompress_stream,
+                                                const decode_table &table, uint8_t zero_padding, bool multi,
+                                                const uint8_t *src, size_t src_len)
+{
+    // 编码数据从当前字节的第 skipped 位开始，以当前字节为第 0 个字节，以下的位置均由此算起
+    uint8_t skipped = (8 - (decode_stream.remain_bits() & 7)) & 7;
+    const uint8_t *mem = nullptr;
+    uint64_t total = 0;     // 编码数据的字节数，从输入流读取时读到末尾才知道
+    bool at_end = false;
+    if (src) {
+        uint64_t offset = decode_stream.size() - (decode_stream.remain_bits() + 7) / 8;
+        mem = src + offset;
+        total = src_len - offset;
+        at_end = true;
+    }
+
+    // 每次只处理一个窗口：各线程各两段，窗口之后多取 BIT_STREAM_PADDING 个字节，供窗口内最后一个符号越过窗口末尾时读取
+    thread_pool pool(thread_count);
+    uint64_t chunk_bits = uint64_t(HUFFMAN_SPECULATIVE_CHUNK) * 8;
+    uint64_t window_chunks = 2 * pool.size();
+    uint64_t window_bits = chunk_bits * window_chunks;
+
+    // 窗口缓冲区：从输入流读取时保存第 buf_base 个字节起的 filled 个字节，其后补 0；
+    // 数据在内存中时只用于复制末尾不足 BIT_STREAM_PADDING 的窗口
+    vector<uint8_t> buf(window_bits / 8 + BIT_STREAM_PADDING + 2, 0);
+    uint64_t buf_base = 0, filled = 0;
+    if (!src && skipped) buf[filled++] = decode_stream.readbits(8 - skipped);
+
+    uint64_t pos = skipped;   // 前一段真正的结束位置，即下一段真正的起始位置，跨窗口保持
+    uint64_t end = UINT64_MAX;
+    for (uint64_t w_begin = skipped; pos < end; w_begin += window_bits) {
+        uint64_t base = w_begin >> 3;
+        uint64_t need = ((w_begin + window_bits + 7) >> 3) + BIT_STREAM_PADDING - base;
+
+        // 取得窗口的数据 data，data[0] 为第 base 个字节
+        const uint8_t *data;
+        if (src) {
+            if (base + need <= total) {
+                data = mem + base;
+            } else {
+                uint64_t n = base < total ? total - base : 0;
+                if (n) memcpy(&buf[0], mem + base, n);
+                memset(&buf[n], 0, buf.size() - n);
+                data = &buf[0];
+            }
+        } else {
+            // 上一个窗口之后多取的字节即为本窗口开头的字节，移到缓冲区开头
+            uint64_t keep = buf_base + filled - base;
+            memmove(&buf[0], &buf[base - buf_base], keep);
+            buf_base = base;
+            filled = keep;
+            while (filled < need && decode_stream.remain_bits() >= 8) {
+                uint32_t n = uint32_t(min<uint64_t>(need - filled, decode_stream.remain_bits() >> 3));
+                decode_stream.readbytes(&buf[filled], n);
+                filled += n;
+            }
+            if (filled < need) {
+                at_end = true;
+                total = base + filled;
+            }
+            memset(&buf[filled], 0, buf.size() - filled);
+            data = &buf[0];
+        }
+
+        // 未读到末尾时窗口之后还有至少 BIT_STREAM_PADDING 个字节，末尾补的 0 不在窗口内
+        if (at_end) {
+            if (total * 8 < skipped + zero_padding) return SOURCE_ERR;
+            end = total * 8 - zero_padding;
+        }
+        uint64_t w_end = min(end, w_begin + window_bits);
+
+        // 窗口内各段的位置都相对于 data 计算
+        uint64_t origin = base * 8;
+        uint64_t chunks = (w_end - w_begin + chunk_bits - 1) / chunk_bits;
+        deque< future<speculative_chunk_t> > pending;
+        for (uint64_t k = 0; k < chunks; k++) {
+            uint64_t b = w_begin + k * chunk_bits - origin;
+            uint64_t bound = min(w_end, w_begin + (k + 1) * chunk_bits) - origin;
+            pending.push_back(pool.submit([data, b, bound, &table, multi]() {
+                speculative_chunk_t chunk;
+                DecodeSpeculativeChunk(data, b, bound, table, multi, chunk);
+                return chunk;
+            }));
+        }
+
+        for (uint64_t k = 0; k < chunks; k++) {
+            speculative_chunk_t chunk = pending.front().get();
+            pending.pop_front();
+            uint64_t bound = min(w_end, w_begin + (k + 1) * chunk_bits) - origin;
+
+            // 从真正的起始位置逐个解码，直到到达推测解码经过的某个符号起始位置，此后两者的结果相同；
+            // 前一段最后一个符号越过了本段时本段没有符号
+            uint64_t cur = pos - origin;
+            ibitbuffer in;
+            in.open(data, cur);
+            size_t j = 0;
+            while (cur < bound) {
+                while (j < chunk.starts.size() && chunk.starts[j] < cur) j++;
+                if (j < chunk.starts.size() && chunk.starts[j] == cur) {
+                    decompress_stream.writbytes(&chunk.symbols[j], chunk.symbols.size() - j);
+                    cur = chunk.end;
+                    break;
+                }
+                if (j == chunk.starts.size()) {
+                    // 同步窗口内未能同步，从真正的起始位置重新解码本段
+                    DecodeSpeculativeChunk(data, cur, bound, table, multi, chunk);
+                    decompress_stream.writbytes(chunk.symbols.data(), chunk.symbols.size());
+                    cur = chunk.end;
+                    break;
+                }
+                decompress_stream.writbyte(table.decode(in));
+                cur = in.tell(data);
+            }
+            pos = cur + origin;
+        }
+    }
+
+    // 最后一个符号越过了编码数据的末尾，数据被截断或损坏
+    return pos == end ? HUFFMAN_OK : SOURCE_ERR;
+}
+
+/**
+ * @brief 解码结束、关闭输出之后检查读写是否出错：读文件或输入流出错时返回 SOURCE_ERR，写出错时返回 DST_ERR，
+ *        流水线方式下读线程、写线程的错误也由此报告
+ */
+static Huffman::huffman_err check_streams(Huffman::huffman_err err, const ibitstream &in, const obitstream &out)
+{
+    if(err != Huffman::HUFFMAN_OK) return err;
+    if(in.failed()) return Huffman::SOURCE_ERR;
+    return out.failed() ? Huffman::DST_ERR : Huffman::HUFFMAN_OK;
+}
+
+Huffman::huffman_err Huffman::decompress(const char *src_file, const char *dst_file, decode_mode mode)
+{
+    // 打开待解压的文件，流水线方式下由读线程预读
+    phase_timer timer(stats[PHASE_DECODE]);
+    ifstream infile;
+    unique_ptr<prefetch_istream> prefetch;
+    ibitstream decode_stream;
+    if(pipeline) {
+        infile.open(src_file, ifstream::in | ifstream::binary);
+        if(!infile) return SOURCE_ERR;
+        prefetch.reset(new prefetch_istream(infile));
+        decode_stream.open(*prefetch);
+    } else if(!decode_stream.open(src_file)) return SOURCE_ERR;
+
+    // 创建解压后的文件，流水线方式下由写线程写出
+    ofstream outfile;
+    unique_ptr<writebehind_ostream> writer;
+    obitstream decompress_stream;
+    if(pipeline) {
+        outfile.open(dst_file, ofstream::out | ofstream::binary);
+        if(!outfile) return DST_ERR;
+        writer.reset(new writebehind_ostream(outfile));
+        decompress_stream.open(*writer);
+    } else if(!decompress_stream.open(dst_file)) return DST_ERR;
+
+    // 分块格式：文件末尾有块索引时并行解码，否则依次解码
+    vector<block_index_t> index;
+    if(decode_stream.peekbits(8) == FORMAT_BLOCK && thread_count != 1 && ReadBlockIndex(src_file, index)) {
+        // 各线程自行打开文件，先结束读写线程并关闭文件
+        decompress_stream.close();
+        decode_stream.close();
+        writer.reset();
+        outfile.close();
+        prefetch.reset();
+        infile.close();
+
+        // 各线程自行读写文件，读写时间无法与解码分开，全部计入 PHASE_DECODE
+        huffman_err err = DecompressBlocksParallel(src_file, dst_file, index);
+        uint64_t src_len = 0, dst_len = 0;
+        for (const block_index_t &item : index) {
+            src_len += item.src_len;
+            dst_len += item.dst_len;
+        }
+        timer.stop(src_len, dst_len);
+        return err;
+    }
+
+    // 单一比特流没有索引，数据量较大时推测式并行解码
+    // 源文件能映射到内存时推测式解码直接读取映射的数据，流水线方式下仍由读线程读取
+    ifstream src_stat(src_file, ifstream::in | ifstream::binary | ifstream::ate);
+    bool speculative = resolve_threads(thread_count) > 1 && uint64_t(src_stat.tellg()) >= HUFFMAN_PARALLEL_MIN_LENGTH;
+    mapped_file mapped;
+    if(speculative && !pipeline) mapped.open(src_file);
+
+    huffman_err err = DecompressStream(decode_stream, decompress_stream, mode, speculative, mapped.data(), mapped.size());
+    decompress_stream.close();
+    err = check_streams(err, decode_stream, decompress_stream);
+    decode_stream.close();
+    StopDecodeTimer(timer, decode_stream, decompress_stream, mapped.size());
+    return err;
+}
+
+Huffman::huffman_err Huffman::decompress(std::istream &src, std::ostream &dst, decode_mode mode)
+{
+    phase_timer timer(stats[PHASE_DECODE]);
+    if(!src) return SOURCE_ERR;
+    if(!dst) return DST_ERR;
+
+    // 流水线方式下由读线程预读、写线程写出，写线程在函数返回前结束
+    unique_ptr<prefetch_istream> prefetch(pipeline ? new prefetch_istream(src) : nullptr);
+    unique_ptr<writebehind_ostream> writer(pipeline ? new writebehind_ostream(dst) : nullptr);
+
+    ibitstream decode_stream;
+    if(!decode_stream.open(prefetch ? *prefetch : src)) return SOURCE_ERR;
+
+    obitstream decompress_stream;
+    if(!decompress_stream.open(writer ? *writer : dst)) return DST_ERR;
+
+    huffman_err err = DecompressStream(decode_stream, decompress_stream, mode, false);
+    decompress_stream.close();
+    err = check_streams(err, decode_stream, decompress_stream);
+    StopDecodeTimer(timer, decode_stream, decompress_stream);
+    return err;
+}
+
+Huffman::huffman_err Huffman::decompress(const uint8_t *src, size_t len, std::vector<uint8_t> &dst, decode_mode mode)
+{
+    phase_timer timer(stats[PHASE_DECODE]);
+    ibitstream decode_stream;
+    decode_stream.open(src, len);
+
+    obitstream decompress_stream;
+    decompress_stream.open(dst);
+
+    bool speculative = resolve_threads(thread_count) > 1 && len >= HUFFMAN_PARALLEL_MIN_LENGTH;
+    huffman_err err = DecompressStream(decode_stream, decompress_stream, mode, speculative, src, len);
+    decompress_stream.close();
+    StopDecodeTimer(timer, decode_stream, decompress_stream, len);
+    return err;
+}
+
+Huffman::huffman_err Huffman::decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_capacity, size_t &dst_len,
+                                         decode_mode mode)
+{
+    phase_timer timer(stats[PHASE_DECODE]);
+    ibitstream decode_stream;
+    decode_stream.open(src, len);
+
+    obitstream decompress_stream;
+    decompress_stream.open(dst, dst_capacity);
+
+    bool speculative = resolve_threads(thread_count) > 1 && len >= HUFFMAN_PARALLEL_MIN_LENGTH;
+    huffman_err err = DecompressStream(decode_stream, decompress_stream, mode, speculative, src, len);
+    decompress_stream.close();
+    StopDecodeTimer(timer, decode_stream, decompress_stream, len);
+
+    dst_len = decompress_stream.size();
+    if (err == HUFFMAN_OK && decompress_stream.overflow()) err = DST_ERR;
+    return err;
+}
+
+/**
+ * @brief 自适应格式：把一段数据计入各符号的出现次数，再据此重建码表
+ */
+void Huffman::AdaptCodes(uint32_t *counts, const uint8_t *src, uint32_t len)
+{
+    histogram hist;
+    hist.add(src, len);
+    uint64_t total = 0;
+    for (unsigned i = 0; i < 256; i++) {
+        counts[i] += hist[i];
+        total += counts[i];
+    }
+    if (total > HUFFMAN_ADAPTIVE_LIMIT) {
+        for (unsigned i = 0; i < 256; i++) {
+            counts[i] = (counts[i] + 1) >> 1;
+        }
+    }
+
+    for (unsigned i = 0; i < 256; i++) {
+        symbol_array[i].count = counts[i];
+    }
+    BuildCodeLengths();
+    BuildHuffmanDict();
+}
+
+/**
+ * @brief 依次读取自适应格式的各段并解码，每段之后与编码端同步重建码表
+ */
+Huffman::huffman_err Huffman::DecodeAdaptive(ibitstream &decode_stream, obitstream &decompress_stream, decode_mode mode)
+{
+    // 码表按编码端的最大码长重建
+    Huffman model;
+    model.max_code_length = decode_stream.readbits(8);
+    uint32_t counts[256];
+    fill(counts, counts + 256, 1);
+    model.AdaptCodes(counts, nullptr, 0);
+
+    vector<uint8_t> segment(HUFFMAN_ADAPTIVE_SEGMENT + DECODE_MULTI_SYMBOLS);
+    uint32_t code_arr[256];
+    uint8_t bits_arr[256];
+    decode_table table;
+    while (true) {
+        if (decode_stream.remain_bits() < 32) return SOURCE_ERR;
+        uint32_t len = decode_stream.readbits(32);
+        if (!len) break;
+        if (len == HUFFMAN_ADAPTIVE_SYNC) {
+            decode_stream.align();
+            continue;
+        }
+        if (len > HUFFMAN_ADAPTIVE_SEGMENT) return SOURCE_ERR;
+
+        for (unsigned i = 0; i < 256; i++) {
+            code_arr[i] = model.symbol_array[i].code;
+            bits_arr[i] = model.symbol_array[i].bits;
+        }
+        if (!table.build(code_arr, bits_arr)) return SOURCE_ERR;
+
+        uint32_t i = 0;
+        if (mode == DECODE_MULTI) {
+            table.build_multi();
+            while (i + DECODE_MULTI_SYMBOLS <= len && decode_stream.remain_bits() >= DECODE_TABLE_BITS) {
+                i += table.decode_multi(decode_stream, &segment[i]);
+            }
+        }
+        while (i < len && decode_stream.remain_bits()) {
+            segment[i++] = table.decode(decode_stream);
+        }
+        // 最后一个码字读过了数据末尾时，解出的符号来自末尾补的 0
+        if (i < len || decode_stream.overrun()) return SOURCE_ERR;
+
+        decompress_stream.writbytes(&segment[0], len);
+        model.AdaptCodes(counts, &segment[0], len);
+    }
+    return HUFFMAN_OK;
+}
+
+Huffman::huffman_err Huffman::TrainCodebook(const char *sample_file, uint32_t id, const char *codebook_file)
+{
+    if(!GetFreqTable(sample_file)) return FILE_OPEN_ERR;
+    return SaveCodebook(id, codebook_file);
+}
+
+Huffman::huffman_err Huffman::TrainCodebook(const uint8_t *src, size_t len, uint32_t id, const char *codebook_file)
+{
+    GetFreqTable(src, len);
+    return SaveCodebook(id, codebook_file);
+}
+
+/**
+ * @brief 由各符号的出现次数构造码本，写入码本文件后载入
+ */
+Huffman::huffman_err Huffman::SaveCodebook(uint32_t id, const char *codebook_file)
+{
+    if (!id) return SOURCE_ERR;
+
+    // 所有符号都要有码字，之后压缩的数据中可能出现样本中没有的符号
+    for (unsigned i = 0; i < 256; i++) {
+        symbol_array[i].count += 1;
+    }
+    BuildCodeLengths();
+    BuildHuffmanDict();
+
+    obitstream out;
+    if (!out.open(codebook_file)) return DST_ERR;
+    out.writbits(HUFFMAN_CODEBOOK_MAGIC, 32);
+    out.writbits(id, 32);
+    WriteCodeLengths(out);
+    out.close();
+
+    return LoadCodebook(codebook_file);
+}
+
+Huffman::huffman_err Huffman::LoadCodebook(const char *codebook_file, uint32_t *id)
+{
+    ibitstream in;
+    if (!in.open(codebook_file)) return FILE_OPEN_ERR;
+    if (in.remain_bits() < 64 || in.readbits(32) != HUFFMAN_CODEBOOK_MAGIC) return SOURCE_ERR;
+    uint32_t book_id = in.readbits(32);
+
+    codebook_t book;
+    memset(book.bits, 0, sizeof(book.bits));
+    if (!book_id || ReadCodeLengths(in, book.bits) != HUFFMAN_OK) return SOURCE_ERR;
+    for (unsigned i = 0; i < 256; i++) {
+        if (!book.bits[i]) return SOURCE_ERR;
+    }
+    CanonicalCodes(book.bits, book.code);
+    if (!book.table.build(book.code, book.bits)) return SOURCE_ERR;
+    book.table.build_multi();
+
+    codebooks[book_id] = book;
+    if (id) *id = book_id;
+    return HUFFMAN_OK;
+}
+
+/**
+ * @brief 解码使用码本压缩的数据
+ */
+Huffman::huffman_err Huffman::DecodeCodebook(ibitstream &decode_stream, obitstream &decompress_stream, decode_mode mode)
+{
+    uint64_t id, len;
+    if (!read_varint(decode_stream, id) || !read_varint(decode_stream, len)) return SOURCE_ERR;
+    map<uint32_t, codebook_t>::const_iterator it = codebooks.find(uint32_t(id));
+    if (id > 0xFFFFFFFF || it == codebooks.end()) return SOURCE_ERR;
+    const decode_table &table = it->second.table;
+
+    uint8_t out[BIT_STREAM_BUFFER_LEHGTH + DECODE_MULTI_SYMBOLS];
+    while (len) {
+        uint32_t n = uint32_t(min<uint64_t>(len, BIT_STREAM_BUFFER_LEHGTH));
+        uint32_t i = 0;
+        if (mode == DECODE_MULTI) {
+            while (i + DECODE_MULTI_SYMBOLS <= n && decode_stream.remain_bits() >= DECODE_TABLE_BITS) {
+                i += table.decode_multi(decode_stream, out + i);
+            }
+        }
+        while (i < n && decode_stream.remain_bits()) {
+            out[i++] = table.decode(decode_stream);
+        }
+        if (i < n || decode_stream.overrun()) return SOURCE_ERR;
+
+        decompress_stream.writbytes(out, n);
+        len -= n;
+    }
+    return HUFFMAN_OK;
+}
+
+/**
+ * @brief 把 256 种上下文（前一字节）按其后各符号的分布聚为至多 k 组，cluster[ctx] 为所属的组，返回实际的组数
+ *        counts[ctx * 256 + c] 为上下文 ctx 之后符号 c 的出现次数；以按所属组的分布编码所需的位数为代价做 k-means
+ */
+static unsigned cluster_contexts(const vector<uint64_t> &counts, unsigned k, uint8_t *cluster)
+{
+    memset(cluster, 0, 256);
+
+    // 出现过的上下文，以及各自按自身分布编码所需的位数（即下限）
+    vector<unsigned> active;
+    double self[256] = {0};
+    uint64_t totals[256] = {0};
+    for (unsigned ctx = 0; ctx < 256; ctx++) {
+        const uint64_t *n = &counts[ctx * 256];
+        for (unsigned c = 0; c < 256; c++) totals[ctx] += n[c];
+        for (unsigned c = 0; c < 256; c++) {
+            if (n[c]) self[ctx] += n[c] * log2(double(totals[ctx]) / n[c]);
+        }
+        if (totals[ctx]) active.push_back(ctx);
+    }
+    if (k > active.size()) k = active.size();
+    if (k <= 1) return 1;
+
+    // 各组中每个符号按平滑后的频率估计的码长，空的组代价为无穷大
+    vector<double> cost(k * 256);
+    auto set_cost = [&cost](unsigned j, const uint64_t *hist) {
+        uint64_t total = 0;
+        for (unsigned c = 0; c < 256; c++) total += hist[c];
+        for (unsigned c = 0; c < 256; c++) {
+            cost[j * 256 + c] = total ? -log2((hist[c] + 0.5) / (total + 128.0)) : HUGE_VAL;
+        }
+    };
+    auto coding_cost = [&counts, &cost](unsigned ctx, unsigned j) {
+        const uint64_t *n = &counts[ctx * 256];
+        const double *w = &cost[j * 256];
+        double bits = 0.0;
+        for (unsigned c = 0; c < 256; c++) {
+            if (n[c]) bits += n[c] * w[c];
+        }
+        return bits;
+    };
+
+    // 初始的各组：先取出现次数最多的上下文，之后每次取按已有各组编码时比其下限多用的位数最多的上下文
+    vector<double> best(256, HUGE_VAL);
+    unsigned center = active[0];
+    for (unsigned ctx : active) {
+        if (totals[ctx] > totals[center]) center = ctx;
+    }
+    unsigned groups = 0;
+    while (groups < k) {
+        set_cost(groups, &counts[center * 256]);
+        for (unsigned ctx : active) {
+            best[ctx] = min(best[ctx], coding_cost(ctx, groups));
+        }
+        groups++;
+
+        double worst = 0.0;
+        for (unsigned ctx : active) {
+            if (best[ctx] - self[ctx] > worst) {
+                worst = best[ctx] - self[ctx];
+                center = ctx;
+            }
+        }
+        // 多出的位数不足以抵消一张码长表（256 个符号时约 200 字节）时不再增加组
+        if (worst < 256.0 * 8) break;
+    }
+
+    // 交替地把每个上下文分到代价最小的组、按分组重新计算各组的分布，直到分组不再变化
+    vector<uint64_t> hist(groups * 256);
+    for (unsigned iter = 0; iter < 16; iter++) {
+        bool changed = false;
+        for (unsigned ctx : active) {
+            unsigned j_best = 0;
+            double c_best = HUGE_VAL;
+            for (unsigned j = 0; j < groups; j++) {
+                double c = coding_cost(ctx, j);
+                if (c < c_best) {
+                    c_best = c;
+                    j_best = j;
+                }
+            }
+            if (iter == 0 || cluster[ctx] != j_best) changed = true;
+            cluster[ctx] = uint8_t(j_best);
+        }
+        if (!changed) break;
+
+        fill(hist.begin(), hist.end(), 0);
+        for (unsigned ctx : active) {
+            for (unsigned c = 0; c < 256; c++) hist[cluster[ctx] * 256 + c] += counts[ctx * 256 + c];
+        }
+        for (unsigned j = 0; j < groups; j++) {
+            set_cost(j, &hist[j * 256]);
+        }
+    }
+
+    // 去掉空的组，按出现的顺序重新编号
+    int renumber[HUFFMAN_MAX_CONTEXTS];
+    fill(renumber, renumber + HUFFMAN_MAX_CONTEXTS, -1);
+    unsigned used = 0;
+    for (unsigned ctx : active) {
+        if (renumber[cluster[ctx]] < 0) renumber[cluster[ctx]] = used++;
+    }
+    for (unsigned ctx = 0; ctx < 256; ctx++) {
+        cluster[ctx] = totals[ctx] ? uint8_t(renumber[cluster[ctx]]) : 0;
+    }
+    return used;
+}
+
+/**
+ * @brief 一阶上下文模型：按前一字节所属的组选择码表编码，写入 encode_stream
+ */
+void Huffman::EncodeContext(const uint8_t *src, size_t len)
+{
+    // 统计各前一字节之后各符号的出现次数
+    vector<uint64_t> counts(256 * 256, 0);
+    uint8_t prev = 0;
+    for (size_t i = 0; i < len; i++) {
+        counts[prev * 256 + src[i]]++;
+        prev = src[i];
+    }
+
+    // 数据较少时减少组数
+    unsigned k = min<unsigned>(context_tables, HUFFMAN_MAX_CONTEXTS);
+    k = unsigned(min<uint64_t>(k, max<uint64_t>(len / HUFFMAN_CONTEXT_MIN_SYMBOLS, 1)));
+    uint8_t cluster[256];
+    unsigned groups = cluster_contexts(counts, k, cluster);
+
+    vector<uint64_t> hist(groups * 256, 0);
+    for (unsigned ctx = 0; ctx < 256; ctx++) {
+        for (unsigned c = 0; c < 256; c++) hist[cluster[ctx] * 256 + c] += counts[ctx * 256 + c];
+    }
+
+    // 组数与各前一字节所属的组
+    uint8_t width = 0;
+    while ((groups - 1) >> width) width++;
+    encode_stream.writbits(FORMAT_CONTEXT, 8);
+    encode_stream.writbits(groups - 1, 8);
+    for (unsigned ctx = 0; ctx < 256; ctx++) {
+        encode_stream.writbits(cluster[ctx], width);
+    }
+
+    // 为每组构造码表并写入其码长表
+    Huffman builder;
+    builder.max_code_length = max_code_length;
+    vector<uint32_t> codes(groups * 256, 0);
+    vector<uint8_t> bits(groups * 256, 0);
+    for (unsigned j = 0; j < groups; j++) {
+        for (unsigned c = 0; c < 256; c++) {
+            builder.symbol_array[c].count = hist[j * 256 + c];
+        }
+        builder.BuildCompleteCodes();
+        builder.WriteCodeLengths(encode_stream);
+        for (unsigned c = 0; c < 256; c++) {
+            codes[j * 256 + c] = builder.symbol_array[c].code;
+            bits[j * 256 + c] = builder.symbol_array[c].bits;
+        }
+    }
+
+    encode_stream.writbits(uint32_t(uint64_t(len) >> 32), 32);
+    encode_stream.writbits(uint32_t(len), 32);
+
+    // 按前一字节所属的组查码表
+    const uint32_t *ctx_code[256];
+    const uint8_t *ctx_bits[256];
+    for (unsigned ctx = 0; ctx < 256; ctx++) {
+        ctx_code[ctx] = &codes[cluster[ctx] * 256];
+        ctx_bits[ctx] = &bits[cluster[ctx] * 256];
+    }
+    prev = 0;
+    EncodeBatched(src, len, [&](uint8_t c, uint32_t &code, uint8_t &bits) {
+        code = ctx_code[prev][c];
+        bits = ctx_bits[prev][c];
+        prev = c;
+    });
+}
+
+/**
+ * @brief 解码一阶上下文模型的数据
+ */
+Huffman::huffman_err Huffman::DecodeContext(ibitstream &decode_stream, obitstream &decompress_stream)
+{
+    if (decode_stream.remain_bits() < 8) return SOURCE_ERR;
+    unsigned groups = decode_stream.readbits(8) + 1;
+    if (groups > HUFFMAN_MAX_CONTEXTS) return SOURCE_ERR;
+
+    uint8_t width = 0;
+    while ((groups - 1) >> width) width++;
+    uint8_t cluster[256];
+    for (unsigned ctx = 0; ctx < 256; ctx++) {
+        cluster[ctx] = decode_stream.readbits(width);
+        if (cluster[ctx] >= groups) return SOURCE_ERR;
+    }
+
+    vector<decode_table> tables(groups);
+    for (unsigned j = 0; j < groups; j++) {
+        uint32_t code_arr[256] = {0};
+        uint8_t bits_arr[256] = {0};
+        if (ReadCodeLengths(decode_stream, bits_arr) != HUFFMAN_OK) return SOURCE_ERR;
+        CanonicalCodes(bits_arr, code_arr);
+        if (!tables[j].build(code_arr, bits_arr)) return SOURCE_ERR;
+    }
+
+    uint64_t len = uint64_t(decode_stream.readbits(32)) << 32;
+    len |= decode_stream.readbits(32);
+    if (decode_stream.overrun()) return SOURCE_ERR;
+
+    // 每个符号用其前一字节所属组的码表解码
+    const decode_table *ctx_table[256];
+    for (unsigned ctx = 0; ctx < 256; ctx++) {
+        ctx_table[ctx] = &tables[cluster[ctx]];
+    }
+    uint8_t out[BIT_STREAM_BUFFER_LEHGTH];
+    uint8_t prev = 0;
+    while (len) {
+        uint32_t n = uint32_t(min<uint64_t>(len, BIT_STREAM_BUFFER_LEHGTH));
+        for (uint32_t i = 0; i < n; i++) {
+            if (!decode_stream.remain_bits()) return SOURCE_ERR;
+            prev = ctx_table[prev]->decode(decode_stream);
+            out[i] = prev;
+        }
+        if (decode_stream.overrun()) return SOURCE_ERR;
+        decompress_stream.writbytes(out, n);
+        len -= n;
+    }
+    return HUFFMAN_OK;
+}
+
+/**
+ * @brief 按文件格式依次解码输入流中的全部数据
+ */
+Huffman::huffman_err Huffman::DecompressStream(ibitstream &decode_stream, obitstream &decompress_stream,
+                                               decode_mode mode, bool speculative, const uint8_t *src, size_t src_len)
+{
+    // 分块格式：各块有自己的码长表
+    uint8_t format = decode_stream.peekbits(8);
+    if(format == FORMAT_BLOCK) {
+        decode_stream.skipbits(8);
+        return DecompressBlocks(decode_stream, decompress_stream);
+    }
+
+    // 自适应格式：码表随已解出的数据更新
+    if(format == FORMAT_ADAPTIVE) {
+        decode_stream.skipbits(8);
+        return DecodeAdaptive(decode_stream, decompress_stream, mode);
+    }
+
+    // 码本格式：码表来自已载入的码本
+    if(format == FORMAT_CODEBOOK) {
+        decode_stream.skipbits(8);
+        return DecodeCodebook(decode_stream, decompress_stream, mode);
+    }
+
+    // 上下文模型：按前一字节选择码表，每次只能解出一个符号
+    if(format == FORMAT_CONTEXT) {
+        decode_stream.skipbits(8);
+        return DecodeContext(decode_stream, decompress_stream);
+    }
+
+    // 从文件头部信息中得到各符号的码字，并据此建立查找表
+    uint32_t code_arr[256] = {0};
+    uint8_t bits_arr[256] = {0};
+    decode_table table;
+    bool header_ok;
+    uint8_t streams = 1;
+    if(format == FORMAT_CANONICAL || format == FORMAT_MULTI_STREAM) {
+        // 范式霍夫曼编码：由码长表直接得到码字，无需重建霍夫曼树
+        decode_stream.skipbits(8);
+        header_ok = ReadCodeLengths(decode_stream, bits_arr) == HUFFMAN_OK;
+        CanonicalCodes(bits_arr, code_arr);
+        if(format == FORMAT_MULTI_STREAM) {
+            streams = decode_stream.readbits(8);
+            header_ok = header_ok && streams > 1 && streams <= HUFFMAN_MAX_STREAMS;
+            decode_stream.align();
+        }
+    } else if(!(format & 0x80) && decode_stream.remain_bits()) {
+        // 旧格式：重建霍夫曼树，由树上各叶子的码字建立查找表
+        decode_tree_node root_node;
+        header_ok = RecoverTree(decode_stream, &root_node) &&
+                    RecoverCodes(&root_node, 0, 0, code_arr, bits_arr);
+    } else {
+        header_ok = false;
+    }
+
+    if(!header_ok || !table.build(code_arr, bits_arr)) return SOURCE_ERR;
+
+    // 多子流格式
+    if(streams > 1) {
+        return DecodeStreams(decode_stream, decompress_stream, table, streams, *max_element(bits_arr, bits_arr + 256));
+    }
+
+    // 读取文件末尾补的0的个数
+    uint8_t zero_padding;
+    zero_padding = decode_stream.readbit() << 2;
+    zero_padding |= decode_stream.readbit() << 1;
+    zero_padding |= decode_stream.readbit();
+
+    // 单一比特流没有索引，数据量较大时推测式并行解码
+    if(speculative) {
+        if(mode == DECODE_MULTI) table.build_multi();
+        return DecodeSpeculative(decode_stream, decompress_stream, table, zero_padding, mode == DECODE_MULTI,
+                                 src, src_len);
+    }
+
+    // 解压缩，解出的符号先存入局部缓冲区，攒满后整块写入输出流
+    uint8_t out[BIT_STREAM_BUFFER_LEHGTH + DECODE_MULTI_SYMBOLS];
+    uint32_t out_len = 0;
+
+    // 剩余有效位数不少于多符号表的下标位数时，一次查表可解出多个符号
+    if(mode == DECODE_MULTI) {
+        table.build_multi();
+        while(decode_stream.remain_bits() >= uint32_t(zero_padding + DECODE_TABLE_BITS)) {
+            out_len += table.decode_multi(decode_stream, out + out_len);
+            if(out_len >= BIT_STREAM_BUFFER_LEHGTH) {
+                decompress_stream.writbytes(out, out_len);
+                out_len = 0;
+            }
+        }
+    }
+
+    // 每次查表解出一个符号
+    while(decode_stream.remain_bits() > zero_padding) {
+        out[out_len++] = table.decode(decode_stream);
+        if(out_len >= BIT_STREAM_BUFFER_LEHGTH) {
+            decompress_stream.writbytes(out, out_len);
+            out_len = 0;
+        }
+    }
+    // 最后一个码字读过了数据末尾，或末尾剩下的位数与补 0 的个数不符，说明数据被截断或损坏
+    if(decode_stream.overrun() || decode_stream.remain_bits() != zero_padding) return SOURCE_ERR;
+    decompress_stream.writbytes(out, out_len);
+
+    return HUFFMAN_OK;
+}
+
+/**
+ * @brief 从输入流读取至多 n 个字节，耗时计入 PHASE_READ
+ */
+size_t Huffman::ReadInput(std::istream &in, uint8_t *x, size_t n)
+{
+    double start = wall_clock();
+    in.read((char *)x, n);
+    n = in.gcount();
+    stats[PHASE_READ].add(wall_clock() - start, 0.0, n, 0);
+    return n;
+}
+
+void Huffman::StopEncodeTimer(phase_timer &timer, double read_start, uint64_t bytes_in)
+{
+    double write_time = encode_stream.io_time();
+    stats[PHASE_WRITE].add(write_time, 0.0, 0, encode_stream.size());
+    timer.stop(bytes_in, encode_stream.size(), stats[PHASE_READ].wall_time - read_start + write_time);
+}
+
+void Huffman::StopDecodeTimer(phase_timer &timer, const ibitstream &in, const obitstream &out, uint64_t src_len)
+{
+    stats[PHASE_READ].add(in.io_time(), 0.0, in.size(), 0);
+    stats[PHASE_WRITE].add(out.io_time(), 0.0, 0, out.size());
+    timer.stop(max<uint64_t>(in.size(), src_len), out.size(), in.io_time() + out.io_time());
+}
+
+void Huffman::ResetStats()
+{
+    for (unsigned i = 0; i < PHASE_NUM; i++) {
+        stats[i].clear();
+    }
+}
+
+const char *Huffman::PhaseName(phase_t phase)
+{
+    static const char *names[PHASE_NUM] = { "read", "count", "tree", "dict", "statistics", "encode", "decode", "write" };
+    return phase < PHASE_NUM ? names[phase] : "unknown";
+}
+
+void Huffman::ShowStats(std::ostream &os) const
+{
+    char  line[] = "+------------+------------+------------+----------------+----------------+------------+";
+    char title[] = "|   Phase    |  Wall (s)  |  CPU (s)   |    Bytes In    |   Bytes Out    |    MB/s    |";
+
+    os << line << endl;
+    os << title << endl;
+    os << line << endl;
+
+    // 读写时间只计墙上时间，其 CPU 时间含在相邻的阶段中
+    double total = 0.0, io = 0.0;
+    ios_base::fmtflags flags = os.flags();
+    streamsize precision = os.precision();
+    os << fixed;
+    for (unsigned i = 0; i < PHASE_NUM; i++) {
+        const phase_stats &phase = stats[i];
+        if (!phase.calls) continue;
+
+        total += phase.wall_time;
+        if (i == PHASE_READ || i == PHASE_WRITE) io += phase.wall_time;
+
+        os << "| " << left << setw(11) << PhaseName(phase_t(i)) << "| ";
+        os << right << setw(10) << setprecision(6) << phase.wall_time << " | ";
+        if (i == PHASE_READ || i == PHASE_WRITE) {
+            os << setw(10) << "-" << " | ";
+        } else {
+            os << setw(10) << setprecision(6) << phase.cpu_time << " | ";
+        }
+        os << setw(14) << phase.bytes_in << " | ";
+        os << setw(14) << phase.bytes_out << " | ";
+        if (phase.bytes_in || phase.bytes_out) {
+            os << setw(10) << setprecision(2) << phase.mbps() << " |" << endl;
+        } else {
+            os << setw(10) << "-" << " |" << endl;
+        }
+    }
+    os << line << endl;
+
+    os << "Total Time: ";
+    os << left << setw(13) << setprecision(6) << total;
+    os << "I/O Time: ";
+    os << left << setw(13) << setprecision(6) << io;
+    os << "I/O Share: ";
+    os << setprecision(2) << (total > 0.0 ? io / total * 100.0 : 0.0) << "%" << endl;
+
+    // 编译时开启分配统计时，再列出各阶段的分配次数、字节数与峰值
+    if (alloc_stats_enabled()) {
+        char  alloc_line[] = "+------------+------------+----------------+----------------+----------------+";
+        char alloc_title[] = "|   Phase    |   Calls    |     Allocs     |  Alloc Bytes   |   Peak Bytes   |";
+
+        os << alloc_line << endl;
+        os << alloc_title << endl;
+        os << alloc_line << endl;
+        for (unsigned i = 0; i < PHASE_NUM; i++) {
+            const phase_stats &phase = stats[i];
+            if (!phase.calls) continue;
+
+            os << "| " << left << setw(11) << PhaseName(phase_t(i)) << "| ";
+            os << right << setw(10) << phase.calls << " | ";
+            os << setw(14) << phase.allocs << " | ";
+            os << setw(14) << phase.alloc_bytes << " | ";
+            os << setw(14) << phase.peak_bytes << " |" << endl;
+        }
+        os << alloc_line << endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void Huffman::ShowResult()
+{
+    char  line[] = "+-------------+---------+-----------------+-------------+----------------------------+";
+    char title[] = "|   Symbol    |  Count  |    Frequency    | Code Length |            Code            |";
+    char c7_13[][6] = { "\\a'  ", "\\b'  ", "\\t'  ", "\\n'  ", "\\v'  ", "\\f'  ", "\\r'  "};
+    char symbol;
+
+    cout << line << endl;
     cout << title << endl;
     cout << line << endl;
 
@@ -330,7 +2206,7 @@ void Huffman::ShowResult()
             cout << left << setw(15) << scientific << setprecision(3) << symbol_array[i].freq << " | ";
             cout << left << setw(11) << int(symbol_array[i].bits) << " | ";
             for (unsigned j = 0; j < symbol_array[i].bits; j++)
-                cout << int(symbol_array[i].binary_code[j]);
+                cout << ((symbol_array[i].code >> (symbol_array[i].bits - 1 - j)) & 1);
             cout << right << setw(28 - symbol_array[i].bits) << '|' << endl;
 
             cout << line << endl;
@@ -349,5 +2225,13 @@ void Huffman::ShowResult()
     cout << "Efficiency: ";
     cout << left << setw(12) << setprecision(6) << efficiency;
 
+    if (max_code_length) {
+        cout << endl;
+        cout << "Max Code Length: ";
+        cout << left << setw(13) << int(max_code_length);
+        cout << "Efficiency Loss: ";
+        cout << left << setw(12) << setprecision(6) << efficiency_loss;
+    }
+
     cout << endl;
 }
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cstring>
+#include "huffman_stream.h"
+
+using namespace std;
+
+/*************************************************************************
+*  class huffman_encoder
+*************************************************************************/
+
+huffman_encoder::huffman_encoder(uint8_t max_code_length) :
+    segment(HUFFMAN_ADAPTIVE_SEGMENT), segment_fill(0), segment_len(HUFFMAN_ADAPTIVE_FIRST_SEGMENT),
+    out_pos(0), total(0), done(false)
+{
+    model.max_code_length = max_code_length;
+    model.encode_stream.open(out);
+    model.encode_stream.writbits(Huffman::FORMAT_ADAPTIVE, 8);
+    model.encode_stream.writbits(max_code_length, 8);
+
+    // 初始时各符号等概，之后每段按已编码的数据重建码表
+    fill(counts, counts + 256, 1);
+    model.AdaptCodes(counts, nullptr, 0);
+}
+
+void huffman_encoder::encode_segment()
+{
+    model.encode_stream.writbits(segment_fill, 32);
+    model.EncodeSymbols(&segment[0], segment_fill);
+    model.AdaptCodes(counts, &segment[0], segment_fill);
+    segment_fill = 0;
+    if (segment_len < HUFFMAN_ADAPTIVE_SEGMENT) segment_len *= 2;
+}
+
+size_t huffman_encoder::push(const uint8_t *src, size_t len)
+{
+    size_t used = 0;
+    while (!done && used < len && pending() < HUFFMAN_STREAM_BACKLOG) {
+        uint32_t n = uint32_t(min<size_t>(len - used, segment_len - segment_fill));
+        memcpy(&segment[segment_fill], src + used, n);
+        segment_fill += n;
+        used += n;
+        if (segment_fill == segment_len) encode_segment();
+    }
+    total += used;
+    return used;
+}
+
+void huffman_encoder::flush()
+{
+    if (done) return;
+    if (segment_fill) encode_segment();
+
+    // 同步点之后补 0 对齐到字节边界，使已输出的字节足以解出全部已接收的数据
+    obitstream &stream = model.encode_stream;
+    stream.writbits(HUFFMAN_ADAPTIVE_SYNC, 32);
+    if (stream.freebits() != 8) stream.writbits(0, stream.freebits());
+    stream.flush();
+}
+
+void huffman_encoder::finish()
+{
+    if (done) return;
+    if (segment_fill) encode_segment();
+    model.encode_stream.writbits(0, 32);
+    model.encode_stream.close();
+    done = true;
+}
+
+size_t huffman_encoder::pull(uint8_t *dst, size_t capacity)
+{
+    size_t n = min(capacity, pending());
+    if (n) memcpy(dst, &out[out_pos], n);
+    out_pos += n;
+
+    // 已取出的部分超过一半时移除，out 的长度不超过积压上限的两倍左右
+    if (out_pos == out.size()) {
+        out.clear();
+        out_pos = 0;
+    } else if (out_pos > out.size() / 2) {
+        out.erase(out.begin(), out.begin() + out_pos);
+        out_pos = 0;
+    }
+    return n;
+}
+
+
+/*************************************************************************
+*  class huffman_decoder
+*************************************************************************/
+
+huffman_decoder::huffman_decoder(Huffman::decode_mode mode) :
+    mode(mode), in(BIT_STREAM_PADDING, 0), in_len(0), in_bit(0),
+    segment(HUFFMAN_ADAPTIVE_SEGMENT + DECODE_MULTI_SYMBOLS), segment_fill(0), segment_len(0),
+    out_pos(0), state(STATE_HEADER), err(Huffman::HUFFMAN_OK)
+{
+    fill(counts, counts + 256, 1);
+}
+
+size_t huffman_decoder::push(const uint8_t *src, size_t len)
+{
+    if (state == STATE_DONE || err != Huffman::HUFFMAN_OK) return 0;
+
+    // 移除已解码的整字节，再把新数据接在后面
+    size_t consumed = in_bit >> 3;
+    memmove(&in[0], &in[consumed], in_len - consumed);
+    in_len -= consumed;
+    in_bit &= 7;
+
+    size_t n = in_len < HUFFMAN_STREAM_INPUT ? min<size_t>(len, HUFFMAN_STREAM_INPUT - in_len) : 0;
+    in.resize(in_len + n + BIT_STREAM_PADDING);
+    memcpy(&in[in_len], src, n);
+    memset(&in[in_len + n], 0, BIT_STREAM_PADDING);
+    in_len += n;
+
+    decode();
+    return n;
+}
+
+size_t huffman_decoder::pull(uint8_t *dst, size_t capacity)
+{
+    size_t n = min(capacity, pending());
+    if (n) memcpy(dst, &out[out_pos], n);
+    out_pos += n;
+
+    if (out_pos == out.size()) {
+        out.clear();
+        out_pos = 0;
+    } else if (out_pos > out.size() / 2) {
+        out.erase(out.begin(), out.begin() + out_pos);
+        out_pos = 0;
+    }
+
+    // 之前可能因输出过多而暂停解码
+    decode();
+    return n;
+}
+
+void huffman_decoder::decode()
+{
+    ibitbuffer reader;
+    while (err == Huffman::HUFFMAN_OK && state != STATE_DONE && pending() < HUFFMAN_STREAM_BACKLOG) {
+        uint64_t avail = uint64_t(in_len) * 8 - in_bit;
+        reader.open(&in[0], in_bit);
+
+        if (state == STATE_HEADER) {
+            // 格式字节与最大码长
+            if (avail < 16) return;
+            if (reader.readbits(8) != Huffman::FORMAT_ADAPTIVE) {
+                err = Huffman::SOURCE_ERR;
+                return;
+            }
+            model.max_code_length = reader.readbits(8);
+            model.AdaptCodes(counts, nullptr, 0);
+            in_bit += 16;
+            state = STATE_LENGTH;
+        } else if (state == STATE_LENGTH) {
+            if (avail < 32) return;
+            uint32_t len = reader.readbits(16) << 16;
+            len |= reader.readbits(16);
+            in_bit += 32;
+
+            if (!len) {
+                state = STATE_DONE;
+            } else if (len == HUFFMAN_ADAPTIVE_SYNC) {
+                in_bit = (in_bit + 7) & ~uint64_t(7);
+            } else if (len > HUFFMAN_ADAPTIVE_SEGMENT) {
+                err = Huffman::SOURCE_ERR;
+            } else {
+                uint32_t code_arr[256];
+                uint8_t bits_arr[256];
+                for (unsigned i = 0; i < 256; i++) {
+                    code_arr[i] = model.symbol_array[i].code;
+                    bits_arr[i] = model.symbol_array[i].bits;
+                }
+                if (!table.build(code_arr, bits_arr)) {
+                    err = Huffman::SOURCE_ERR;
+                    return;
+                }
+                if (mode == Huffman::DECODE_MULTI) table.build_multi();
+                segment_len = len;
+                segment_fill = 0;
+                state = STATE_SYMBOLS;
+            }
+        } else {
+            decode_symbols();
+            if (segment_fill < segment_len) return;
+
+            out.insert(out.end(), segment.begin(), segment.begin() + segment_len);
+            model.AdaptCodes(counts, &segment[0], segment_len);
+            state = STATE_LENGTH;
+        }
+    }
+}
+
+void huffman_decoder::decode_symbols()
+{
+    const uint8_t *base = &in[0];
+    uint64_t end = uint64_t(in_len) * 8;
+    ibitbuffer reader;
+    reader.open(base, in_bit);
+    uint32_t i = segment_fill;
+
+    // 剩余的位不少于最长的码字时一定能解出下一次查表的符号，不必检查
+    if (mode == Huffman::DECODE_MULTI) {
+        while (i + DECODE_MULTI_SYMBOLS <= segment_len && reader.tell(base) + 32 <= end) {
+            i += table.decode_multi(reader, &segment[i]);
+        }
+    }
+    while (i < segment_len && reader.tell(base) + 32 <= end) {
+        segment[i++] = table.decode(reader);
+    }
+
+    // 接近数据末尾时逐个检查，解出的符号越过末尾说明其码字尚未完整收到
+    while (i < segment_len) {
+        ibitbuffer saved = reader;
+        uint8_t symbol = table.decode(reader);
+        if (reader.tell(base) > end) {
+            reader = saved;
+            break;
+        }
+        segment[i++] = symbol;
+    }
+
+    in_bit = reader.tell(base);
+    segment_fill = i;
+}
@@ -1,7 +1,11 @@
 #include <iostream>
+#include <fstream>
 #include <string>
+#include <cstring>
 #include <iomanip>
 #include <windows.h>
+#include <io.h>
+#include <fcntl.h>
 
 #include "huffman.h"
 #include "huffman_ui.h"
@@ -16,40 +20,72 @@ unsigned _menu(string &input);
 void _compress(Huffman *code, std::string src, bool FileOrStr);
 void _de_compress(Huffman *code, std::string &src);
 void _encode(Huffman *code, std::string src, bool FileOrStr);
+int _stream(Huffman *code, char *argv[], bool compress);
 
 
 /*************************************************************************
 * public function
 *************************************************************************/
 
-// 命令行模式
-void CommandMode(char *argv[])
+// 命令行模式，返回进程的退出码
+int CommandMode(char *argv[])
 {
     string src;
     Huffman code;
-    if(argv[1][1] == 'f') {
-        src = argv[2];
+    int status = 0;
+
+    // -p、-t 放在其他选项之前，可以同时使用：
+    // -p 执行完毕后把各阶段的耗时输出到标准错误，不影响输出到标准输出的数据；-t 由单独的线程读写文件
+    char **args = argv;
+    bool show_stats = false;
+    while(args[1] && args[2] && (!strcmp(args[1], "-p") || !strcmp(args[1], "-t"))) {
+        if(args[1][1] == 'p') show_stats = true;
+        else code.pipeline = true;
+        args++;
+    }
+
+    if(args[1][1] == 'f') {
+        src = args[2];
         _encode(&code, src, 1);
-    } else if(argv[1][1] == 's') {
-        src = argv[2];
+    } else if(args[1][1] == 's') {
+        src = args[2];
         _encode(&code, src, 0);
-    } else if(argv[1][1] == 'u') {
-        src = argv[2];
+    } else if(args[1][1] == 'u') {
+        src = args[2];
         _de_compress(&code, src);
+    } else if(args[1][1] == 'a') {
+        status = _stream(&code, args, true);
+    } else if(args[1][1] == 'x') {
+        status = _stream(&code, args, false);
     }
     else {
-        std::cout << "Usage: " << argv[0] << " [-?] [-h] [-f xxx] [-s xxx]" << endl;
-        std::cout << "    " << left << setw(10) << "-?";
-        std::cout << "Display help." << endl;
-        std::cout << "    " << left << setw(10) << "-h";
-        std::cout << "Display help." << endl;
-        std::cout << "    " << left << setw(10) << "-f xxx";
-        std::cout << "treat xxx as file path and encode the file." << endl;
-        std::cout << "    " << left << setw(10) << "-s xxx";
-        std::cout << "treat xxx as string and encode it." << endl;
-        std::cout << "    " << left << setw(10) << "-u xxx";
-        std::cout << "treat xxx as compressed file and decompress it." << endl;
+        // -?、-h 显示帮助，其他无法识别的选项把用法输出到标准错误后返回非 0
+        bool help = args[1][1] == '?' || args[1][1] == 'h';
+        ostream &os = help ? std::cout : std::cerr;
+        os << "Usage: " << argv[0] << " [-?] [-h] [-p] [-t] [-f xxx] [-s xxx] [-u xxx] [-a [xxx] [yyy]] [-x [xxx] [yyy]]" << endl;
+        os << "    " << left << setw(12) << "-?";
+        os << "Display help." << endl;
+        os << "    " << left << setw(12) << "-h";
+        os << "Display help." << endl;
+        os << "    " << left << setw(12) << "-f xxx";
+        os << "treat xxx as file path and encode the file." << endl;
+        os << "    " << left << setw(12) << "-s xxx";
+        os << "treat xxx as string and encode it." << endl;
+        os << "    " << left << setw(12) << "-u xxx";
+        os << "treat xxx as compressed file and decompress it." << endl;
+        os << "    " << left << setw(12) << "-a xxx yyy";
+        os << "compress xxx to yyy in one pass (adaptive), \"-\" or omitted means stdin / stdout." << endl;
+        os << "    " << left << setw(12) << "-x xxx yyy";
+        os << "decompress xxx to yyy, \"-\" or omitted means stdin / stdout." << endl;
+        os << "    " << left << setw(12) << "-p";
+        os << "put before another option, print time and throughput of each phase to stderr when done." << endl;
+        os << "    " << left << setw(12) << "-t";
+        os << "put before another option, read and write files on separate threads to overlap I/O with coding." << endl;
+        return help ? 0 : 1;
     }
+
+    if(show_stats) code.ShowStats(cerr);
+    return status;
 }
 
 // 独立模式
@@ -262,3 +298,48 @@ void _encode(Huffman *code, std::string src, bool FileOrStr)
         break;
     }
 }
+
+// 命令行模式下不经交互地压缩（自适应编码）或解压，源或目标为 "-" 或省略时使用标准输入、标准输出
+int _stream(Huffman *code, char *argv[], bool compress)
+{
+    const char *src = argv[2];
+    const char *dst = src ? argv[3] : NULL;
+    bool use_stdin = !src || !strcmp(src, "-");
+    bool use_stdout = !dst || !strcmp(dst, "-");
+
+    ifstream infile;
+    ofstream outfile;
+    if (use_stdin) {
+        _setmode(_fileno(stdin), _O_BINARY);
+    } else {
+        infile.open(src, ifstream::in | ifstream::binary);
+        if (!infile) {
+            cerr << "failed to open \"" << src << "\"!" << endl;
+            return 1;
+        }
+    }
+    if (use_stdout) {
+        _setmode(_fileno(stdout), _O_BINARY);
+    } else {
+        outfile.open(dst, ofstream::out | ofstream::binary);
+        if (!outfile) {
+            cerr << "failed to creat \"" << dst << "\"!" << endl;
+            return 1;
+        }
+    }
+
+    istream &in = use_stdin ? cin : infile;
+    ostream &out = use_stdout ? cout : outfile;
+    Huffman::huffman_err op_state = compress ? code->compress(in, out) : code->decompress(in, out);
+    if (op_state != Huffman::HUFFMAN_OK) {
+        cerr << (compress ? "Compress" : "Decompress") << " failed!" << endl;
+        return 1;
+    }
+
+    // 输出流在写出或刷新时出错（如磁盘已满、管道的读端已关闭）同样视为失败
+    if (!out) {
+        cerr << "failed to write \"" << (use_stdout ? "stdout" : dst) << "\"!" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -5,10 +5,9 @@ using namespace std;
 int main(int argc, char *argv[])
 {
     if (argc > 1) {
-        CommandMode(argv);
-    } else {
-        IndependenceMode();
+        return CommandMode(argv) ? 1 : 0;
     }
 
+    IndependenceMode();
     return 0;
 }
\ No newline at end of file
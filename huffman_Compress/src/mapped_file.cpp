@@ -0,0 +1,106 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+bool mapped_file::open(const char *filename)
+{
+    close();
+
+    // FILE_FLAG_SEQUENTIAL_SCAN 提示系统按顺序预读
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+    len = size_t(file_size.QuadPart);
+
+    // 空文件无法映射，按长度为 0 的数据处理
+    if (!len) {
+        CloseHandle(file);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        len = 0;
+        return false;
+    }
+    ptr = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr) {
+        CloseHandle(mapping);
+        len = 0;
+        return false;
+    }
+    handle = mapping;
+    return true;
+}
+
+void mapped_file::close()
+{
+    if (ptr) UnmapViewOfFile(ptr);
+    if (handle) CloseHandle((HANDLE)handle);
+    ptr = nullptr;
+    len = 0;
+    handle = nullptr;
+}
+
+#else
+
+bool mapped_file::open(const char *filename)
+{
+    close();
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    len = size_t(st.st_size);
+
+    // 空文件无法映射，按长度为 0 的数据处理
+    if (!len) {
+        ::close(fd);
+        return true;
+    }
+
+    void *p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);    // 映射建立后即可关闭文件描述符
+    if (p == MAP_FAILED) {
+        len = 0;
+        return false;
+    }
+
+    // 各遍都从头到尾顺序读取：提示内核加大预读，并尽量使用大页减少缺页与 TLB 开销
+    madvise(p, len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+    ptr = (const uint8_t *)p;
+    return true;
+}
+
+void mapped_file::close()
+{
+    if (ptr) munmap((void *)ptr, len);
+    ptr = nullptr;
+    len = 0;
+}
+
+#endif
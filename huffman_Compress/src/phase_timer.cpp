@@ -0,0 +1,69 @@
+#include <chrono>
+#include <ctime>
+#include "phase_timer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+using namespace std;
+
+double wall_clock()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef _WIN32
+
+double cpu_clock()
+{
+    // Windows 的 clock() 返回的是墙上时间，需从进程的内核态与用户态时间相加得到（单位 100ns）
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 1e-7;
+}
+
+#else
+
+double cpu_clock()
+{
+    timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts)) return double(clock()) / CLOCKS_PER_SEC;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
+
+double phase_stats::mbps() const
+{
+    uint64_t bytes = bytes_in ? bytes_in : bytes_out;
+    return wall_time > 0.0 ? bytes / 1e6 / wall_time : 0.0;
+}
+
+void phase_timer::start(phase_stats &stats)
+{
+    current = &stats;
+    alloc = alloc_begin();
+    wall = wall_clock();
+    cpu = cpu_clock();
+}
+
+void phase_timer::stop(uint64_t bytes_in, uint64_t bytes_out, double io_time)
+{
+    if (!current) return;
+
+    // 计时的精度有限，扣除读写时间后可能略小于 0
+    double elapsed = wall_clock() - wall - io_time;
+    current->add(elapsed > 0.0 ? elapsed : 0.0, cpu_clock() - cpu, bytes_in, bytes_out);
+
+    alloc_counters used = alloc_end(alloc);
+    current->allocs += used.count;
+    current->alloc_bytes += used.bytes;
+    if (used.peak > current->peak_bytes) current->peak_bytes = used.peak;
+    current = nullptr;
+}
@@ -0,0 +1,238 @@
+#include "pipe_stream.h"
+
+using namespace std;
+
+/*************************************************************************
+*  class buffer_ring
+*************************************************************************/
+
+buffer_ring::buffer_ring(size_t buffer_size, unsigned buffer_count) :
+    size(buffer_size), pending(0), finished(false), cancelled(false), error(false)
+{
+    if (buffer_count < 2) buffer_count = 2;
+    buffers.resize(buffer_count);
+    lengths.resize(buffer_count, 0);
+    for (unsigned i = 0; i < buffer_count; i++) {
+        buffers[i].resize(buffer_size);
+        free_list.push_back(i);
+    }
+}
+
+bool buffer_ring::acquire(unsigned &i)
+{
+    unique_lock<mutex> lock(mtx);
+    cv.wait(lock, [this]() { return cancelled || !free_list.empty(); });
+    if (cancelled) return false;
+    i = free_list.front();
+    free_list.pop_front();
+    return true;
+}
+
+void buffer_ring::submit(unsigned i, size_t len)
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        lengths[i] = len;
+        ready.push_back(i);
+        pending++;
+    }
+    cv.notify_all();
+}
+
+bool buffer_ring::receive(unsigned &i, size_t &len)
+{
+    unique_lock<mutex> lock(mtx);
+    cv.wait(lock, [this]() { return cancelled || finished || !ready.empty(); });
+    if (cancelled || ready.empty()) return false;
+    i = ready.front();
+    len = lengths[i];
+    ready.pop_front();
+    return true;
+}
+
+void buffer_ring::release(unsigned i)
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        free_list.push_back(i);
+        pending--;
+    }
+    cv.notify_all();
+}
+
+void buffer_ring::wait_idle()
+{
+    unique_lock<mutex> lock(mtx);
+    cv.wait(lock, [this]() { return cancelled || !pending; });
+}
+
+void buffer_ring::finish()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        finished = true;
+    }
+    cv.notify_all();
+}
+
+void buffer_ring::cancel()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        cancelled = true;
+    }
+    cv.notify_all();
+}
+
+void buffer_ring::fail()
+{
+    lock_guard<mutex> lock(mtx);
+    error = true;
+}
+
+bool buffer_ring::failed()
+{
+    lock_guard<mutex> lock(mtx);
+    return error;
+}
+
+
+/*************************************************************************
+*  class prefetch_istream
+*************************************************************************/
+
+prefetch_istream::prefetch_istream(istream &src, size_t buffer_size, unsigned buffer_count) :
+    istream(nullptr), buf(src, buffer_size, buffer_count)
+{
+    rdbuf(&buf);
+}
+
+prefetch_istream::~prefetch_istream()
+{
+}
+
+prefetch_istream::prefetch_buf::prefetch_buf(istream &src, size_t buffer_size, unsigned buffer_count) :
+    ring(buffer_size, buffer_count), src(src), holding(false), current(0)
+{
+    setg(nullptr, nullptr, nullptr);
+    reader = thread(&prefetch_buf::read_loop, this);
+}
+
+prefetch_istream::prefetch_buf::~prefetch_buf()
+{
+    // 读线程可能还在等待空闲的缓冲区，取消后才能结束
+    ring.cancel();
+    reader.join();
+}
+
+prefetch_istream::prefetch_buf::int_type prefetch_istream::prefetch_buf::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    // 当前的缓冲区已读完，归还给读线程，再取下一个读好的缓冲区
+    if (holding) {
+        ring.release(current);
+        holding = false;
+    }
+    size_t len;
+    if (!ring.receive(current, len)) {
+        // 读线程出错：抛出异常，istream 的读取函数捕获后置 badbit
+        if (ring.failed()) throw ios_base::failure("prefetch_istream: read error");
+        return traits_type::eof();
+    }
+    holding = true;
+
+    char *p = (char *)ring.buffer(current);
+    setg(p, p, p + len);
+    return traits_type::to_int_type(*p);
+}
+
+void prefetch_istream::prefetch_buf::read_loop()
+{
+    unsigned i;
+    while (src && ring.acquire(i)) {
+        src.read((char *)ring.buffer(i), ring.buffer_size());
+        size_t len = src.gcount();
+        if (len) {
+            ring.submit(i, len);
+        } else {
+            ring.release(i);
+        }
+    }
+    // 读出错而不是读到末尾：先记录错误再结束，使 underflow 取完已读好的数据后能够区分
+    if (src.bad()) ring.fail();
+    ring.finish();
+}
+
+
+/*************************************************************************
+*  class writebehind_ostream
+*************************************************************************/
+
+writebehind_ostream::writebehind_ostream(ostream &dst, size_t buffer_size, unsigned buffer_count) :
+    ostream(nullptr), buf(dst, buffer_size, buffer_count)
+{
+    rdbuf(&buf);
+}
+
+writebehind_ostream::~writebehind_ostream()
+{
+}
+
+writebehind_ostream::writebehind_buf::writebehind_buf(ostream &dst, size_t buffer_size, unsigned buffer_count) :
+    ring(buffer_size, buffer_count), dst(dst), current(0)
+{
+    ring.acquire(current);
+    char *p = (char *)ring.buffer(current);
+    setp(p, p + ring.buffer_size());
+    writer = thread(&writebehind_buf::write_loop, this);
+}
+
+writebehind_ostream::writebehind_buf::~writebehind_buf()
+{
+    // 写出剩余的数据后结束写线程
+    submit();
+    ring.finish();
+    writer.join();
+}
+
+writebehind_ostream::writebehind_buf::int_type writebehind_ostream::writebehind_buf::overflow(int_type c)
+{
+    submit();
+    if (ring.failed()) return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int writebehind_ostream::writebehind_buf::sync()
+{
+    // 写线程空闲时才能在本线程中刷新 dst
+    submit();
+    ring.wait_idle();
+    if (!ring.failed() && !dst.flush()) ring.fail();
+    return ring.failed() ? -1 : 0;
+}
+
+void writebehind_ostream::writebehind_buf::submit()
+{
+    size_t len = pptr() - pbase();
+    if (!len) return;
+    ring.submit(current, len);
+    ring.acquire(current);
+    char *p = (char *)ring.buffer(current);
+    setp(p, p + ring.buffer_size());
+}
+
+void writebehind_ostream::writebehind_buf::write_loop()
+{
+    // 写出失败后继续归还缓冲区，使写入的一方不会阻塞，之后的数据全部丢弃
+    unsigned i;
+    size_t len;
+    while (ring.receive(i, len)) {
+        if (!ring.failed() && !dst.write((const char *)ring.buffer(i), len)) ring.fail();
+        ring.release(i);
+    }
+}
@@ -0,0 +1,41 @@
+#include "thread_pool.h"
+
+using namespace std;
+
+thread_pool::thread_pool(unsigned threads) : stop(false)
+{
+    if (!threads) threads = thread::hardware_concurrency();
+    if (!threads) threads = 1;
+
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back(&thread_pool::worker, this);
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    // 等待队列中剩余的任务执行完毕后再退出
+    {
+        lock_guard<mutex> lock(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    for (thread &t : workers) {
+        t.join();
+    }
+}
+
+void thread_pool::worker()
+{
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [this]() { return stop || !tasks.empty(); });
+            if (stop && tasks.empty()) return;
+            task = move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}